@@ -15,6 +15,8 @@
 #include <chrono>
 #include <unistd.h>
 #include <vector>
+#include <map>
+#include <algorithm>
 #include <filesystem>
 #include "UUID.h"
 #include "helper.h"
@@ -36,6 +38,7 @@ namespace PackedTrackable {
     FrameHeader   = 1,
     StartHeader   = 2,
     StopHeader    = 3,
+    DeltaHeader   = 4,	// key or delta frame, see DeltaEncoder
 
     VersionBits   = (0xff00),
 
@@ -164,6 +167,324 @@ namespace PackedTrackable {
     }
   };
 
+  /***************************************************************************
+  *** 
+  *** Delta Frames
+  ***
+  ****************************************************************************/
+
+  // A delta frame packet is a Header of type DeltaHeader, size being the
+  // number of records, followed by
+  //
+  //   uint8   mode		DeltaFrame or KeyFrame
+  //   varint  sequence	increments every frame, a gap invalidates the decoder
+  //   UUID			key frames only
+  //   records		sorted by id
+  //
+  // A record starts with an op byte (Enter, Move or Leave plus the Size and
+  // Flags bits) and the varint id distance to the previous record. Enter
+  // carries zigzag x, y and varint size and flags, Move the zigzag x, y
+  // deltas and size and flags only if they changed. Objects that did not
+  // change are not sent. A key frame enters all objects.
+  
+  namespace Delta
+  {
+    enum Mode { DeltaFrame = 0, KeyFrame = 1 };
+
+    enum Op
+    { Enter     = 0,
+      Move      = 1,
+      Leave     = 2,
+      OpBits    = 3,
+      SizeBit   = (1<<2),
+      FlagsBit  = (1<<3)
+    };
+
+	/* Packet is any byte container, e.g. std::vector<uint8_t> or std::string */
+
+    template <class Packet>
+    inline void putVarint( Packet &packet, uint32_t value )
+    {
+      while ( value >= 0x80 )
+      { packet.push_back( (uint8_t)(value | 0x80) );
+	value >>= 7;
+      }
+      packet.push_back( (uint8_t)value );
+    }
+
+    template <class Packet>
+    inline void putZigZag( Packet &packet, int32_t value )
+    { putVarint( packet, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31) );
+    }
+
+    inline bool getVarint( const uint8_t *&data, const uint8_t *end, uint32_t &value )
+    {
+      value = 0;
+      for ( int shift = 0; shift < 35 && data < end; shift += 7 )
+      { uint8_t byte = *data++;
+	value |= (uint32_t)(byte & 0x7f) << shift;
+	if ( (byte & 0x80) == 0 )
+	  return true;
+      }
+      return false;
+    }
+
+    inline bool getZigZag( const uint8_t *&data, const uint8_t *end, int32_t &value )
+    {
+      uint32_t zigzag;
+      if ( !getVarint( data, end, zigzag ) )
+	return false;
+      value = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+      return true;
+    }
+  } // namespace Delta
+
+  class DeltaEncoder
+  {
+    public:
+    
+      int			keyFrameInterval;
+
+      DeltaEncoder( int keyFrameInterval=30 )
+      : keyFrameInterval( keyFrameInterval ),
+	sequence        ( 0 ),
+	sinceKeyFrame   ( 0 ),
+	needsKeyFrame   ( true )
+      {}
+
+	/* next frame will be a key frame, e.g. on start or when a client connects */
+
+      void reset()
+      { needsKeyFrame = true;
+      }
+
+	/* appends frame as key or delta packet to the last sent frame */
+
+      template <class Packet>
+      void encode( const BinaryFrame &frame, Packet &packet )
+      {
+	bool keyFrame = needsKeyFrame || (keyFrameInterval > 0 && sinceKeyFrame >= keyFrameInterval);
+
+	current.assign( frame.begin(), frame.end() );
+	std::sort( current.begin(), current.end(), []( const Binary &a, const Binary &b ) { return a.v2.tid < b.v2.tid; } );
+
+	size_t headerPos = packet.size();
+	packet.resize( headerPos + sizeof(Header) );
+
+	packet.push_back( keyFrame ? Delta::KeyFrame : Delta::DeltaFrame );
+	Delta::putVarint( packet, ++sequence );
+	if ( keyFrame )
+	{ const uint8_t *uuid = (const uint8_t *)&frame.uuid;
+	  packet.insert( packet.end(), uuid, uuid+sizeof(frame.uuid) );
+	  last.clear();
+	}
+
+	int      numRecords = 0;
+	uint32_t lastId     = 0;
+	int      l          = 0;
+
+	for ( int c = 0; c <= current.size(); ++c )
+	{
+	  const Binary *binary = (c < current.size() ? &current[c] : NULL);
+
+	  for ( ; l < last.size() && (binary == NULL || last[l].v2.tid < binary->v2.tid); ++l, ++numRecords )
+	  { packet.push_back( Delta::Leave );
+	    Delta::putVarint( packet, last[l].v2.tid - lastId );
+	    lastId = last[l].v2.tid;
+	  }
+
+	  if ( binary == NULL )
+	    break;
+
+	  const Binary *previous = (l < last.size() && last[l].v2.tid == binary->v2.tid ? &last[l++] : NULL);
+
+	  if ( previous == NULL )
+	  { packet.push_back( Delta::Enter );
+	    Delta::putVarint( packet, binary->v2.tid - lastId );
+	    Delta::putZigZag( packet, binary->v2.x );
+	    Delta::putZigZag( packet, binary->v2.y );
+	    Delta::putVarint( packet, binary->v2.size );
+	    Delta::putVarint( packet, binary->v2.flags );
+	  }
+	  else
+	  { 
+	    uint8_t op = Delta::Move;
+	    if ( binary->v2.size != previous->v2.size )
+	      op |= Delta::SizeBit;
+	    if ( binary->v2.flags != previous->v2.flags )
+	      op |= Delta::FlagsBit;
+
+	    if ( op == Delta::Move && binary->v2.x == previous->v2.x && binary->v2.y == previous->v2.y )
+	      continue;
+
+	    packet.push_back( op );
+	    Delta::putVarint( packet, binary->v2.tid - lastId );
+	    Delta::putZigZag( packet, binary->v2.x - previous->v2.x );
+	    Delta::putZigZag( packet, binary->v2.y - previous->v2.y );
+	    if ( op & Delta::SizeBit )
+	      Delta::putVarint( packet, binary->v2.size );
+	    if ( op & Delta::FlagsBit )
+	      Delta::putVarint( packet, binary->v2.flags );
+	  }
+
+	  lastId      = binary->v2.tid;
+	  numRecords += 1;
+	}
+
+	Header header( frame.header.timestamp, DeltaHeader );
+	header.size = numRecords;
+	memcpy( &packet[headerPos], &header, sizeof(header) );
+
+	last.swap( current );
+
+	sinceKeyFrame = (keyFrame ? 1 : sinceKeyFrame+1);
+	needsKeyFrame = false;
+      }
+
+    protected:
+      uint32_t			sequence;
+      int			sinceKeyFrame;
+      bool			needsKeyFrame;
+      std::vector<Binary>	last;
+      std::vector<Binary>	current;
+  };
+
+  class DeltaDecoder
+  {
+    public:
+      
+      DeltaDecoder()
+      : sequence( 0 ),
+	valid   ( false )
+      {}
+
+      void reset()
+      { valid = false;
+	objects.clear();
+      }
+
+      bool isValid() const
+      { return valid; }
+
+	/* decodes a DeltaHeader packet into the full frame, fails until the next key frame after a gap */
+
+      bool decode( const uint8_t *data, size_t length, BinaryFrame &frame )
+      {
+	const uint8_t *end = data + length;
+
+	if ( length < sizeof(Header) + 1 )
+	  return false;
+
+	Header header;
+	memcpy( &header, data, sizeof(header) );
+	if ( header.zero != 0 || !header.isType( DeltaHeader ) )
+	  return false;
+	data += sizeof(header);
+
+	uint8_t  mode = *data++;
+	uint32_t seq;
+	if ( !Delta::getVarint( data, end, seq ) )
+	  return invalidate();
+
+	if ( mode == Delta::KeyFrame )
+	{ if ( end - data < (long)sizeof(uuid) )
+	    return invalidate();
+	  memcpy( &uuid, data, sizeof(uuid) );
+	  data += sizeof(uuid);
+	  objects.clear();
+	}
+	else if ( !valid || seq != sequence+1 )
+	  return invalidate();
+
+	sequence = seq;
+
+	uint32_t id = 0;
+	for ( int i = 0; i < header.size; ++i )
+	{
+	  if ( data >= end )
+	    return invalidate();
+
+	  uint8_t  op = *data++;
+	  uint32_t distance;
+	  if ( !Delta::getVarint( data, end, distance ) )
+	    return invalidate();
+	  id += distance;
+
+	  switch ( op & Delta::OpBits )
+	  {
+	    case Delta::Enter:
+	    { int32_t x, y;
+	      uint32_t size, flags;
+	      if ( !Delta::getZigZag( data, end, x ) || !Delta::getZigZag( data, end, y ) ||
+		   !Delta::getVarint( data, end, size ) || !Delta::getVarint( data, end, flags ) )
+		return invalidate();
+
+	      Binary &binary( objects[id] );
+	      binary.v2.tid   = id;
+	      binary.v2.x     = x;
+	      binary.v2.y     = y;
+	      binary.v2.size  = size;
+	      binary.v2.flags = flags;
+	      break;
+	    }
+
+	    case Delta::Move:
+	    { auto iter( objects.find( id ) );
+	      int32_t dx, dy;
+	      if ( iter == objects.end() || !Delta::getZigZag( data, end, dx ) || !Delta::getZigZag( data, end, dy ) )
+		return invalidate();
+
+	      Binary &binary( iter->second );
+	      binary.v2.x += dx;
+	      binary.v2.y += dy;
+
+	      uint32_t value;
+	      if ( op & Delta::SizeBit )
+	      { if ( !Delta::getVarint( data, end, value ) )
+		  return invalidate();
+		binary.v2.size = value;
+	      }
+	      if ( op & Delta::FlagsBit )
+	      { if ( !Delta::getVarint( data, end, value ) )
+		  return invalidate();
+		binary.v2.flags = value;
+	      }
+	      break;
+	    }
+
+	    case Delta::Leave:
+	      objects.erase( id );
+	      break;
+
+	    default:
+	      return invalidate();
+	  }
+	}
+
+	valid = true;
+
+	frame.clear();
+	frame.header = Header( header.timestamp, FrameHeader );
+	frame.uuid   = uuid;
+	for ( auto &iter: objects )
+	  frame.push_back( iter.second );
+	frame.header.size = frame.size();
+
+	return true;
+      }
+
+    protected:
+      uint32_t			sequence;
+      bool			valid;
+      UUID			uuid;
+      std::map<uint32_t,Binary>	objects;
+
+      bool invalidate()
+      { reset();
+	return false;
+      }
+  };
+
   class Stream
   {
     public:
@@ -1726,13 +1726,14 @@ static void runPackedPlayerThread( TrackBase *trackBase )
 void
 TrackBase::trackObjects( ObsvObjects &objects )
 {
-  Trackables<BlobMarkerUnion> &current( *new Trackables<BlobMarkerUnion>() );
+  Trackables<BlobMarkerUnion>::Ptr currentPtr( m_Stage->acquireTrackables() );
+  Trackables<BlobMarkerUnion> &current( *currentPtr );
 
   for ( auto &iter: objects )
   { 
     ObsvObject &object( iter.second );
 
-    current.push_back( Trackable<BlobMarkerUnion>::Ptr( m_Stage->createTrackable()) );
+    current.push_back( m_Stage->allocTrackable() );
     Trackable<BlobMarkerUnion>::Ptr trackable = current.back();
 //    trackable->touchTime( timestamp );
 
@@ -1753,7 +1754,8 @@ TrackBase::trackObjects( ObsvObjects &objects )
     trackable->touchTime ( objects.timestamp );
   }
 
-  m_Stage->latest = Trackables<BlobMarkerUnion>::Ptr( &current );
+  m_Stage->recycleTrackables( m_Stage->latest );
+  m_Stage->latest = currentPtr;
      
   m_Stage->frame_count = objects.frame_id;
   m_Stage->touchTime( objects.timestamp );
@@ -25,6 +25,10 @@
 #include <regex>
 
 #include "UUID.h"
+#include "trackAssignment.h"
+#include "spatialGrid.h"
+#include "blockPool.h"
+#include "kalmanMotion.h"
 
 namespace pv {
 
@@ -172,6 +176,7 @@ public:
   float		Size;
   float		predictedPos[3];
   float		firstImmobilePos[3];
+  KalmanMotion	kalman;
   
   UUID		uuid;
 
@@ -204,6 +209,15 @@ public:
   }
        
 
+	/* copies other without its latent ids, they belong to the stage other is tracked in.
+	   The map of other is swapped out during the copy, so it is not duplicated */
+  inline void assignState( Trackable &other )
+  { LatentIds ids;
+    ids.swap( other.latentIds );
+    *this = other;
+    other.latentIds.swap( ids );
+  }
+
   inline void init( uint64_t timestamp, bool initValues=true )
   { firstTime   = timestamp;
     lastTime    = timestamp;
@@ -224,6 +238,7 @@ public:
     Pos[1]    = this->p[1];
     Pos[2]    = this->p[2];
     Size      = this->size;
+    kalman.reset();
   }
   
   static inline uint64_t getmsec()
@@ -472,6 +487,11 @@ public:
   typename Trackables<Type>::Ptr latest;
   typename Trackables<Type>::Ptr current;
 
+  std::mutex 	mutexSpare;
+  std::vector<typename Trackables<Type>::Ptr> spare;	// recycled trackable vectors
+
+  static const int maxSpare = 4;
+
   uint64_t lastTime;
   uint64_t frame_count;
 
@@ -538,26 +558,54 @@ public:
     touchTime( timestamp );
   }
 
+  typename Trackables<Type>::Ptr acquireTrackables()
+  {
+    { std::lock_guard<std::mutex> guard( mutexSpare );
+      if ( spare.size() > 0 )
+      { typename Trackables<Type>::Ptr trackables( spare.back() );
+	spare.pop_back();
+	return trackables;
+      }
+    }
+    return typename Trackables<Type>::Ptr( new Trackables<Type> );
+  }
+
+	/* keep the vector capacity if nobody else holds the frame */
+  void recycleTrackables( typename Trackables<Type>::Ptr &trackables )
+  {
+    if ( trackables != NULL && trackables.use_count() == 1 )
+    { trackables->clear();
+
+      std::lock_guard<std::mutex> guard( mutexSpare );
+      if ( spare.size() < maxSpare )
+	spare.push_back( trackables );
+    }
+    trackables.reset();
+  }
+
   virtual void swap()
   { 
+    recycleTrackables( latest );
     latest  = current;
-    current = typename Trackables<Type>::Ptr( new Trackables<Type> );
+    current = acquireTrackables();
   }
 
   virtual void reset()
   {
-    latest  = typename Trackables<Type>::Ptr( new Trackables<Type> );
-    current = typename Trackables<Type>::Ptr( new Trackables<Type> );
+    recycleTrackables( latest );
+    recycleTrackables( current );
+    latest  = acquireTrackables();
+    current = acquireTrackables();
   }
   
-  virtual Trackable<Type> *createTrackable()
-  { return new Trackable<Type>();
+	/* object and reference count in one pooled block */
+  virtual typename Trackable<Type>::Ptr allocTrackable()
+  { return std::allocate_shared<Trackable<Type>>( PoolAllocator<Trackable<Type>>() );
   }
 
-
   typename Trackable<Type>::Ptr newTrackable( uint64_t timestamp )
   { 
-    current->push_back(typename Trackable<Type>::Ptr( createTrackable()) );
+    current->push_back( allocTrackable() );
 
     Trackable<Type> &trackable( *current->back() );
     trackable.init( timestamp );
@@ -617,6 +665,12 @@ public:
     float length() const { return sqrt( x*x + y*y + z*z ); }
       
   };
+
+  enum MotionModel
+  {
+    MotionSmooth = 0,	// smoothed motion vector, gated by trackDistance
+    MotionKalman = 1	// constant velocity Kalman filter, Mahalanobis gating
+  };
     
   TrackableStages<Type> subStages;
 #if USE_CAMERA
@@ -637,7 +691,12 @@ public:
   double		trackFilterWeight;
   double		trackSmoothing;
   double		objectMaxSize;
+  MotionModel		motionModel;
+  double		kalmanAcceleration;
+  double		kalmanNoise;
+  double		kalmanGate;
   bool			trackDistance2D;
+  bool			optimalAssignment;
   bool			uniteInSingleStage;
   int			isStarted;
   uint64_t		timestamp;
@@ -649,10 +708,18 @@ public:
 #ifdef TRACKABLE_OBSERVER_H
   TrackableMultiObserver  *observer;
   ObsvObjects		   obsvObjects;
+  uint64_t		   observeDuration;	// usec spent in observers by the last unite()
 #endif
 
   int			(*trackableMask)( Trackable<Type> &trackable );
 
+  TrackAssignment	assignment;
+  SpatialGrid<int>	grid;
+  SpatialGrid<int>	latentGrid;	// indices into latentHosts
+  std::vector<Trackable<Type>*> latentHosts;
+  float			latentHostSpeed;
+  std::vector<int>	neighbours;
+
   struct TrackInfo
   {
     double distance;
@@ -683,7 +750,13 @@ public:
       trackFilterWeight   ( 0.5 ),
       trackSmoothing      ( 0.6 ),
       objectMaxSize       ( 0.0 ),
+      motionModel         ( MotionSmooth ),
+      kalmanAcceleration  ( 2.0 ),
+      kalmanNoise         ( 0.08 ),
+      kalmanGate          ( 9.21 ),
       trackDistance2D     ( true ),
+      optimalAssignment   ( true ),
+      latentHostSpeed     ( 0.0f ),
       privateTimeout	  ( 5000 ),
       immobileTimeout	  ( 60*60*1000 ),
       immobileDistance	  ( 1.0 ),
@@ -693,7 +766,8 @@ public:
       starttime		  ( 0 ),
       trackableMask 	  ( NULL )
 #ifdef TRACKABLE_OBSERVER_H
-  ,   observer            ( NULL )
+  ,   observer            ( NULL ),
+      observeDuration     ( 0 )
 #endif
   {
     this->isMulti = true;
@@ -763,12 +837,17 @@ public:
     printArgHelpImpl( "track.latentLifeTime", 	  latentLifeTime / 1000.0,  "\tkeep latent ids for latentLifeTime seconds" );
     printArgHelpImpl( "track.objectMaxSize",      objectMaxSize,      "\tmax object size before splitting (if implemented)" );
     printArgHelpImpl( "track.trackMotionPredict", trackMotionPredict, "weight of motion prediction in consecutive frames" );
+    printArgHelpImpl( "track.motionModel",        motionModel,        "\tmotion model: 0 = smoothed motion vector, 1 = Kalman filter" );
+    printArgHelpImpl( "track.kalmanAcceleration", kalmanAcceleration, "Kalman: expected acceleration in m/s^2" );
+    printArgHelpImpl( "track.kalmanNoise",        kalmanNoise,        "\tKalman: measurement noise in meter" );
+    printArgHelpImpl( "track.kalmanGate",         kalmanGate,         "\tKalman: max squared Mahalanobis distance to be identified as the same object" );
     printArgHelpImpl( "track.keepTime",           keepTime / 1000.0,           "\t\tsec to keep object in tracked layer even if it is not detected. After that time it is dropped" );
     printArgHelpImpl( "track.minActiveTime",      minActiveTime / 1000.0,      "\tmin time an object has to be active before it appears as being tracked" );
     printArgHelpImpl( "track.minActiveFraction",  minActiveFraction,  "fraction of min Active time the object has to be continuousely detected before it appears as being tracked" );
     printArgHelpImpl( "track.trackFilterWeight",  trackFilterWeight,  "filter weight between old and new values. 0 = copy, 1 = no change" );
     printArgHelpImpl( "track.trackSmoothing",     trackSmoothing,     "\tsmoothing of values. 0 = copy, 1 = no change" );
     printArgHelpImpl( "track.distance2D",         trackDistance2D,    "\tdistance calculation: 0 = 3D, 1 = 2D" );
+    printArgHelpImpl( "track.optimalAssignment",  optimalAssignment,  "assignment of objects between frames and stages: 1 = optimal, 0 = greedy" );
     printArgHelpImpl( "track.privateTimeout",     privateTimeout / 1000.0,     "\tsec to stay in private area until marked as private" );
     printArgHelpImpl( "track.immobileTimeout",    immobileTimeout / 1000.0,     "sec to be immobile until marked as immobile" );
     printArgHelpImpl( "track.immobileDistance",   immobileDistance,     "\tdistance in meter to be moved for not regardes as beeing immobile" );
@@ -806,6 +885,28 @@ public:
     {
       trackMotionPredict = atof( argv[++i] );
     }
+    else if ( strcmp(argv[i],"track.motionModel") == 0 )
+    {
+      ++i;
+      if ( strcmp(argv[i],"kalman") == 0 )
+	motionModel = MotionKalman;
+      else if ( strcmp(argv[i],"smooth") == 0 )
+	motionModel = MotionSmooth;
+      else
+	motionModel = (atoi( argv[i] ) == 1 ? MotionKalman : MotionSmooth);
+    }
+    else if ( strcmp(argv[i],"track.kalmanAcceleration") == 0 )
+    {
+      kalmanAcceleration = atof( argv[++i] );
+    }
+    else if ( strcmp(argv[i],"track.kalmanNoise") == 0 )
+    {
+      kalmanNoise = atof( argv[++i] );
+    }
+    else if ( strcmp(argv[i],"track.kalmanGate") == 0 )
+    {
+      kalmanGate = atof( argv[++i] );
+    }
     else if ( strcmp(argv[i],"track.keepTime") == 0 )
     {
       keepTime = atof( argv[++i] ) * 1000;
@@ -830,6 +931,10 @@ public:
     {
       trackDistance2D = atoi( argv[++i] );
     }
+    else if ( strcmp(argv[i],"track.optimalAssignment") == 0 )
+    {
+      optimalAssignment = atoi( argv[++i] );
+    }
     else if ( strcmp(argv[i],"track.privateTimeout") == 0 )
     {
       privateTimeout = atoi( argv[++i] ) * 1000;
@@ -881,8 +986,8 @@ public:
       Trackable<Type> &subStageTrackable = *subStage[i];
 
       typename Trackable<Type>::Ptr newTrackable;
-      merged.push_back( newTrackable=typename Trackable<Type>::Ptr( this->createTrackable()) );
-      *newTrackable = subStageTrackable;
+      merged.push_back( newTrackable=this->allocTrackable() );
+      newTrackable->assignState( subStageTrackable );
       newTrackable->init( timestamp, false );
     }
   }
@@ -890,54 +995,49 @@ public:
  	/* sort by distances */
   virtual void mergeStage( Trackables<Type> &merged, Trackables<Type> &subStage )
   {
-    std::vector<TrackInfo> trackInfo;
-    
-    bool mergedUsed[merged.size()+1]     = { false };
-    bool subStageUsed[subStage.size()+1] = { false };
-    std::fill_n( mergedUsed,   merged.size()+1, false );
-    std::fill_n( subStageUsed, subStage.size()+1, false );
+    assignment.clear( subStage.size(), merged.size() );
+
+    grid.clear( uniteDistance );
+    for ( int j = ((int)merged.size())-1; j >= 0; --j )
+      grid.add( merged[j]->Pos[0], merged[j]->Pos[1], j );
+    grid.build();
 
 	/* calculate distances from substage to merged stage */
     for ( int i = ((int)subStage.size())-1; i >= 0; --i )
     { Trackable<Type> &subStageTrackable = *subStage[i];
-      for ( int j = ((int)merged.size())-1; j >= 0; --j )
+      grid.query( subStageTrackable.Pos[0], subStageTrackable.Pos[1], uniteDistance, [&]( int j )
       { 
 	double d = subStageTrackable.distanceTo( *merged[j] );
 	if ( d <= uniteDistance )
-	  trackInfo.push_back( TrackInfo({d, i, j}) ); /* { distance, currentIndex, mergedIndex } */
-      }
+	  assignment.add( i, j, d );
+      });
     }
 
- 	/* sort by distances */
-    sort( trackInfo.begin(), trackInfo.end(), compareTrackInfo );
-
 	/* assign corresponding trackables in subStage to merged stage */
-    for ( int i = 0; i < trackInfo.size(); ++i )
-    {
-      TrackInfo &ti( trackInfo[i] );
+    assignment.solve( uniteDistance, optimalAssignment );
 
-	  /* only if they are not already assigned */
-      if ( !subStageUsed[ti.currentIndex] && !mergedUsed[ti.mergedIndex] )
+    for ( int i = ((int)subStage.size())-1; i >= 0; --i )
+    {
+      int j = assignment.rowMatch[i];
+      if ( j >= 0 )
       {
-	Trackable<Type> &mergedTrackable = *merged[ti.mergedIndex];
+	Trackable<Type> &mergedTrackable = *merged[j];
 
 	mergedTrackable.numWeight += 1;
-	mergedTrackable.mixWith( *subStage[ti.currentIndex], 1.0/mergedTrackable.numWeight );
-	subStageUsed[ti.currentIndex] = true;
-	mergedUsed[ti.mergedIndex]    = true;
+	mergedTrackable.mixWith( *subStage[i], 1.0/mergedTrackable.numWeight );
       }
     }
     
 	/* add new trackable with no correspondence */
     for ( int i = ((int)subStage.size())-1; i >= 0; --i )
     { 
-      if ( !subStageUsed[i] )
+      if ( assignment.rowMatch[i] < 0 )
       {
 	Trackable<Type> &subStageTrackable = *subStage[i];
 
 	typename Trackable<Type>::Ptr newTrackable;
-	merged.push_back( newTrackable=typename Trackable<Type>::Ptr( this->createTrackable()) );
-	*newTrackable = subStageTrackable;
+	merged.push_back( newTrackable=this->allocTrackable() );
+	newTrackable->assignState( subStageTrackable );
 	newTrackable->init( timestamp, false );
       }
     }
@@ -966,21 +1066,28 @@ public:
 	Trackable<Type> &trackable = *subStage[i];
 
 	typename Trackable<Type>::Ptr newTrackable;
-	merged.push_back( newTrackable=typename Trackable<Type>::Ptr( this->createTrackable()) );
-	*newTrackable = trackable;
+	merged.push_back( newTrackable=this->allocTrackable() );
+	newTrackable->assignState( trackable );
 	newTrackable->init( timestamp, false );
       }
     }
 
     std::vector<TrackInfo> trackInfo;
     
+    grid.clear( uniteDistance );
+    for ( int i = ((int)merged.size())-1; i >= 0; --i )
+      grid.add( merged[i]->Pos[0], merged[i]->Pos[1], i );
+    grid.build();
+
 	/* calculate distances from trackables in substages */
     for ( int i = ((int)merged.size())-1; i > 0; --i )
-    { for ( int j = i-1; j >= 0; --j )
-      { double d = merged[i]->distanceTo( *merged[j] );
+    { grid.query( merged[i]->Pos[0], merged[i]->Pos[1], uniteDistance, [&]( int j )
+      { if ( j >= i )
+	  return;
+	double d = merged[i]->distanceTo( *merged[j] );
 	if ( d <= uniteDistance )
 	  trackInfo.push_back( TrackInfo({d, i, j}) );
-      }
+      });
     }
 
  	/* sort by distances */
@@ -1107,22 +1214,24 @@ public:
 
     float distance = maxDistance;
 
-    int latentHost = -1;
+    Trackable<Type> *latentHost = NULL;
     
-    for ( int i = ((int)current.size())-1; i >= 0; --i ) // check if there is a younger one in the near
+    std::vector<int> &hosts( latentNeighbours( currentTrackable, maxDistance, currentSpeed, time ) );
+
+    for ( int h = 0; h < hosts.size(); ++h ) // check if there is a younger one in the near
     { 
-      if ( i != currentIndex && current[i]->isActivated )
+      Trackable<Type> &trackable( *latentHosts[hosts[h]] );
+      if ( &trackable != &currentTrackable && trackable.isActivated )
       { 
-	Trackable<Type> &trackable( *current[i] );
 	if ( isCloser( currentTrackable, trackable, currentSpeed, time, distance ) )
-	  latentHost = i;
+	  latentHost = &trackable;
       }
     }
 
-    if ( latentHost >= 0 )
+    if ( latentHost != NULL )
     {
-//      printf( "put %s -> %s\n", currentTrackable.id().c_str(), current[latentHost]->id().c_str() );
-      current[latentHost]->latentIds.put( currentTrackable.id(), currentTrackable.uuid, timestamp );
+//      printf( "put %s -> %s\n", currentTrackable.id().c_str(), latentHost->id().c_str() );
+      latentHost->latentIds.put( currentTrackable.id(), currentTrackable.uuid, timestamp );
     }  
   }
   
@@ -1142,11 +1251,13 @@ public:
 
     float distance = maxDistance;
 
-    for ( int i = ((int)current.size())-1; i >= 0; --i ) // check if there is a trackable with latent latent in the near
+    std::vector<int> &hosts( latentNeighbours( currentTrackable, maxDistance, currentSpeed, time ) );
+
+    for ( int h = 0; h < hosts.size(); ++h ) // check if there is a trackable with latent latent in the near
     { 
-      if ( current[i]->isActivated )
+      Trackable<Type> &trackable( *latentHosts[hosts[h]] );
+      if ( trackable.isActivated )
       { 
-	Trackable<Type> &trackable( *current[i] );
 	std::string lId;
 	if ( trackable.latentIds.get( lId, timestamp ) )
 	{ 
@@ -1161,6 +1272,45 @@ public:
     return latentId;
   }
 
+  	/* activated trackables which can keep or hand out latent ids */
+  void buildLatentHosts( bool withLatentIds )
+  {
+    Trackables<Type> &current( *this->current );
+
+    latentHosts.resize( 0 );
+    latentHostSpeed = 0.0f;
+    latentGrid.clear( latentDistance );
+
+    for ( int i = 0; i < current.size(); ++i )
+    { 
+      Trackable<Type> &trackable( *current[i] );
+
+      if ( trackable.isActivated && (!withLatentIds || trackable.latentIds.size() > 0) )
+      { 
+	Vector3D speedVec( trackable.motionVector[0], trackable.motionVector[1], 0.0 );
+	if ( speedVec.length() > latentHostSpeed )
+	  latentHostSpeed = speedVec.length();
+
+	latentGrid.add( trackable.Pos[0], trackable.Pos[1], latentHosts.size() );
+	latentHosts.push_back( &trackable );
+      }
+    }
+
+    latentGrid.build();
+  }
+
+  	/* latent hosts isCloser() may accept, in descending order of current */
+  std::vector<int> &latentNeighbours( Trackable<Type> &currentTrackable, float maxDistance, float currentSpeed, float time )
+  {
+    float radius = maxDistance + 5.0 * time * (currentSpeed + latentHostSpeed);
+
+    neighbours.resize( 0 );
+    latentGrid.query( currentTrackable.Pos[0], currentTrackable.Pos[1], radius, [this]( int h ) { neighbours.push_back( h ); } );
+    std::sort( neighbours.begin(), neighbours.end(), std::greater<int>() );
+
+    return neighbours;
+  }
+
   float length( float *p )
   {
     double d = 0;
@@ -1212,6 +1362,10 @@ public:
     if ( timestamp == 0 )
       timestamp = getmsec();
 
+#ifdef TRACKABLE_OBSERVER_H
+    observeDuration = 0;
+#endif
+
 	/* merge all substages into a current single layer */
 
     Trackables<Type> &latest ( *this->latest );
@@ -1246,19 +1400,68 @@ public:
     float predictWeight = this->predictWeight( time_diff );
     float time 		= this->motionTime   ( time_diff );
 
+    const bool  kalman     = (motionModel == MotionKalman);
+    const float kalmanTime = (isValidDuration( time_diff ) ? time_diff / 1000.0 : 0.0);
+    const float kalmanQ    = kalmanAcceleration * kalmanAcceleration;
+    const float kalmanR    = kalmanNoise * kalmanNoise;
+
 	/* calculate predicted Positions */
     for ( int i = ((int)current.size())-1; i >= 0; --i )
     { Trackable<Type> &currentTrackable = *current[i];
-      currentTrackable.predictedPos[0] = currentTrackable.Pos[0] + predictWeight * currentTrackable.motionVector[0];
-      currentTrackable.predictedPos[1] = currentTrackable.Pos[1] + predictWeight * currentTrackable.motionVector[1];
-      currentTrackable.predictedPos[2] = currentTrackable.Pos[2] + predictWeight * currentTrackable.motionVector[2];
+      if ( kalman )
+      { if ( !currentTrackable.kalman.valid )
+	  currentTrackable.kalman.init( currentTrackable.Pos[0], currentTrackable.Pos[1], kalmanR );
+	currentTrackable.kalman.predict( kalmanTime, kalmanQ );
+
+	currentTrackable.predictedPos[0] = currentTrackable.kalman.x[0];
+	currentTrackable.predictedPos[1] = currentTrackable.kalman.x[1];
+	currentTrackable.predictedPos[2] = currentTrackable.Pos[2];
+      }
+      else
+      { currentTrackable.predictedPos[0] = currentTrackable.Pos[0] + predictWeight * currentTrackable.motionVector[0];
+	currentTrackable.predictedPos[1] = currentTrackable.Pos[1] + predictWeight * currentTrackable.motionVector[1];
+	currentTrackable.predictedPos[2] = currentTrackable.Pos[2] + predictWeight * currentTrackable.motionVector[2];
+      }
     }
     
+    grid.clear( trackDistance );
+    for ( int j = ((int)merged.size())-1; j >= 0; --j )
+      grid.add( merged[j]->Pos[0], merged[j]->Pos[1], j );
+    grid.build();
+
+    assignment.clear( current.size(), merged.size() );
+
 	/* calculate distances from merged to current */
     for ( int i = ((int)current.size())-1; i >= 0; --i )
     { Trackable<Type> &currentTrackable = *current[i];
 
-      for ( int j = ((int)merged.size())-1; j >= 0; --j )
+      if ( kalman ) /* the gate is a circle of radius sqrt(gate * innovation variance) */
+      {
+	const KalmanMotion &filter( currentTrackable.kalman );
+	float radius = std::min( trackDistance, sqrt( kalmanGate * filter.innovationVar( kalmanR ) ) );
+
+	grid.query( filter.x[0], filter.x[1], radius, [&]( int j )
+	{ Trackable<Type> &mergedTrackable( *merged[j] );
+	  float d2 = filter.mahalanobis2( mergedTrackable.Pos[0], mergedTrackable.Pos[1], kalmanR );
+	  if ( d2 > kalmanGate )
+	    return;
+
+	  double d = mergedTrackable.distanceTo( currentTrackable,
+						 currentTrackable.Pos[0] - filter.x[0],
+						 currentTrackable.Pos[1] - filter.x[1], 0.0 );
+	  if ( d <= trackDistance )
+	  { trackInfo.push_back( TrackInfo({d, i, j}) );
+	    if ( d < trackDistance )
+	      assignment.add( i, j, d2 );
+	  }
+	});
+	continue;
+      }
+
+      float x = currentTrackable.Pos[0] - predictWeight * currentTrackable.motionVector[0];
+      float y = currentTrackable.Pos[1] - predictWeight * currentTrackable.motionVector[1];
+
+      grid.query( x, y, trackDistance, [&]( int j )
       { Trackable<Type> &mergedTrackable( *merged[j] );
 	double d = mergedTrackable.distanceTo( currentTrackable,
 					       predictWeight * currentTrackable.motionVector[0],
@@ -1266,8 +1469,11 @@ public:
 					       predictWeight * currentTrackable.motionVector[2] );
 	
 	if ( d <= trackDistance )
-	  trackInfo.push_back( TrackInfo({d, i, j}) );
-      }
+	{ trackInfo.push_back( TrackInfo({d, i, j}) );
+	  if ( d < trackDistance )
+	    assignment.add( i, j, d );
+	}
+      });
     }
 
 	/* sort by distances */
@@ -1279,16 +1485,10 @@ public:
     std::fill_n(mergedMap, merged.size()+1, -1 );
 
 	/* assign corresponding trackables in merged to current */
-    for ( int i = 0; i < trackInfo.size() && trackInfo[i].distance < trackDistance; ++i )
-    {
-      TrackInfo &ti( trackInfo[i] );
+    assignment.solve( kalman ? kalmanGate : trackDistance, optimalAssignment );
 
-	  /* only if they are not already assigned */
-      if ( currentMap[ti.currentIndex] < 0 && mergedMap[ti.mergedIndex] < 0 )
-      { currentMap[ti.currentIndex] = ti.mergedIndex;
-	mergedMap[ti.mergedIndex]   = ti.currentIndex;
-      }
-    }
+    std::copy( assignment.rowMatch.begin(), assignment.rowMatch.end(), currentMap );
+    std::copy( assignment.colMatch.begin(), assignment.colMatch.end(), mergedMap );
 
 	/* check if an older non assigned trackable is close to an assigned non activated trackable */
     for ( int i = 0; i < trackInfo.size() && trackInfo[i].distance < trackDistance; ++i )
@@ -1330,6 +1530,12 @@ public:
 	currentTrackable.mixWith( *merged[mergedIndex], trackFilterWeight );
 	currentTrackable.lastTime  = now;
 
+	if ( kalman )
+	{ currentTrackable.kalman.update( merged[mergedIndex]->Pos[0], merged[mergedIndex]->Pos[1], kalmanR );
+	  currentTrackable.Pos[0] = currentTrackable.kalman.x[0];
+	  currentTrackable.Pos[1] = currentTrackable.kalman.x[1];
+	}
+
 	currentTrackable.user1     = merged[mergedIndex]->user1;
 	currentTrackable.user2     = merged[mergedIndex]->user2;
 	currentTrackable.splitProb = merged[mergedIndex]->splitProb;
@@ -1343,7 +1549,22 @@ public:
 
       const float minTime = 1.0/80.0;
 
-      if ( time > minTime )
+      if ( kalman )
+      { KalmanMotion &filter( currentTrackable.kalman );
+
+	currentTrackable.motionVector[0] = filter.v[0];
+	currentTrackable.motionVector[1] = filter.v[1];
+	currentTrackable.motionVector[2] = 0;
+	limitSpeed( currentTrackable, 1.0 );
+	filter.v[0] = currentTrackable.motionVector[0];
+	filter.v[1] = currentTrackable.motionVector[1];
+
+	if ( currentMap[i] < 0 ) /* if unused coast along the prediction */
+	{ currentTrackable.Pos[0] = filter.x[0];
+	  currentTrackable.Pos[1] = filter.x[1];
+	}
+      }
+      else if ( time > minTime )
       {
 	if ( currentMap[i] >= 0 ) // mix new motionvector with old
         {
@@ -1380,6 +1601,9 @@ public:
     
 	/* remove unused current trackables if they are old */
 
+    if ( latentDistance > 0.0 )
+      buildLatentHosts( false );
+
     for ( int i = ((int)current.size())-1; i >= 0; --i )
     { Trackable<Type> &currentTrackable( *current[i] );
 
@@ -1463,6 +1687,9 @@ public:
       }
     }
     
+    if ( latentDistance > 0.0 )
+      buildLatentHosts( true );
+
     	/* transfer trackables with activity */
     for ( int i = 0; i < current.size(); ++i )
     { 
@@ -1575,7 +1802,11 @@ public:
       }
       obsvObjects.validCount = validCount;
 
+      uint64_t observeStart = LatencyTracer::usec();
       observer->observe( obsvObjects );
+      observeDuration = LatencyTracer::usec() - observeStart;
+      LatencyTracer::add( LatencyTracer::Observe, observeDuration );
+
       obsvObjects.update();
     }
 #endif
@@ -318,7 +318,7 @@ public:
     }
     
     if ( messages.size() >= batchSize || other.timestamp - lastWrittenTime > batchSec*1000 )
-    { write( messages, other.timestamp );
+    { tracedWrite( messages, other.timestamp );
       lastWrittenTime = other.timestamp;
     }
     
@@ -33,6 +33,7 @@ public:
   lo::Address 	loa;
   
   std::string	version;
+  std::string	addressBuffer;
   bool          msgEmpty;
 
   lo::ServerThread *m_ServerThread;
@@ -224,9 +225,9 @@ public:
   }
 
 
-  inline void addSchemeValue( std::string &string, lo::Message &msg, bool &hasUpdate, bool &hasStatic,bool&hasDynamic, uint64_t timestamp, ObsvObjects *objects=NULL, ObsvObject *object=NULL )
+  inline void addSchemeValue( SchemeToken &token, lo::Message &msg, bool &hasUpdate, bool &hasStatic,bool&hasDynamic, uint64_t timestamp, ObsvObjects *objects=NULL, ObsvObject *object=NULL )
   { 
-    ObsvValue value( getObsvValue( string.c_str(), hasUpdate, hasStatic, hasDynamic, timestamp, objects, object ) );
+    ObsvValue value( schemeValue( token, hasUpdate, hasStatic, hasDynamic, timestamp, objects, object ) );
     if ( std::holds_alternative<float>(value) )
       msg.add( std::get<float>(value) );
     else if ( std::holds_alternative<int32_t>(value) )
@@ -323,21 +324,21 @@ public:
   }
   
   void send( const std::string &prefix, lo::Message &msg )
-  { 
+  { LatencyTracer::Scope scope( LatencyTracer::Write );
     loa.send( version+obsvFilter.kmprefix("/",prefix), msg );
   }
   
-  void addSchemeComponent( ObsvObjects *objects, ObsvObject *object, std::string &component, lo::Message &msg, bool &hasUpdate, bool &hasStatic, bool &hasDynamic, uint64_t timestamp )
+  void addSchemeComponent( ObsvObjects *objects, ObsvObject *object, SchemeComponent &component, lo::Message &msg, bool &hasUpdate, bool &hasStatic, bool &hasDynamic, uint64_t timestamp )
   {
-    if ( component.front() == '<' && component.back() == '>' )
+    if ( component.isValue() )
     {
-      std::string key( component.substr(1,component.length()-2) );
-      addSchemeValue( key, msg, hasUpdate, hasStatic, hasDynamic, timestamp, objects, object );
+      addSchemeValue( component.front(), msg, hasUpdate, hasStatic, hasDynamic, timestamp, objects, object );
       return;
     }
 
-    std::string result( schemeComponentAsString( component, hasUpdate, hasStatic, hasDynamic, timestamp, objects, object ) );
-    msg.add( "s", result.c_str() );
+    schemeBuffer.clear();
+    renderSchemeComponent( component, schemeBuffer, hasUpdate, hasStatic, hasDynamic, timestamp, objects, object );
+    msg.add( "s", schemeBuffer.c_str() );
   }
 
   void reportScheme( std::vector<SchemeMessage> &scheme, uint64_t timestamp, ObsvObjects *objects=NULL, ObsvObject *object=NULL )
@@ -351,15 +352,19 @@ public:
 	bool hasStatic  = false;
 	bool hasDynamic = false;
 
-	std::vector<std::string> &components( scheme[i].components );
+	std::vector<SchemeComponent> &components( scheme[i].components );
       	  
-	std::string adressPattern( schemeComponentAsString( components[0], hasUpdate, hasStatic, hasDynamic, timestamp, objects, object ) );
+	std::string &adressPattern( addressBuffer );
+	adressPattern.clear();
+	renderSchemeComponent( components[0], adressPattern, hasUpdate, hasStatic, hasDynamic, timestamp, objects, object );
 
 	for ( int c = 1; c < components.size(); ++c )
 	  addSchemeComponent( objects, object, components[c], msg, hasUpdate, hasStatic, hasDynamic, timestamp );
 
 	if ( hasUpdate || (hasStatic&&!hasDynamic) || scheme[i].forceUpdate )
+        { LatencyTracer::Scope scope( LatencyTracer::Write );
 	  loa.send( adressPattern, msg );
+	}
       }
     }
   }
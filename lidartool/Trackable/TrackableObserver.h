@@ -10,6 +10,7 @@
 #define TRACKABLE_OBSERVER_H
 
 #include "helper.h"
+#include "latencyTracer.h"
 
 #include <mutex>
 #include <thread>
@@ -27,10 +28,13 @@
 #include <functional>
 #include <filesystem>
 #include <variant>
+#include <unordered_map>
 
 #include "UUID.h"
 
 #include "filterTool.h"
+#include "jsonWriter.h"
+#include "messageQueue.h"
 
 #include "PackedTrackable.h"
 
@@ -853,8 +857,9 @@ class TrackableObserver
 protected:
   std::mutex		 mutex;
   std::thread		*thread;
-  std::atomic<bool>	 isFlushed;
-  bool			 exitThread;
+  std::atomic<bool>	 exitThread;
+  MessageQueue		 messageQueue;		// messages handed to the observer thread
+  std::vector<std::string> threadMessages;
   
   void lock()
   { mutex.lock(); }
@@ -864,15 +869,29 @@ protected:
 
   void flush()
   {
-    uint64_t start_time = getmsec();
-    uint64_t now = start_time;
-    
-    isFlushed = false;
-  
-    while ( !isFlushed && now - start_time < 2000 ) // try to flush for 2 sec
-    { usleep( 10000 );
-      now = getmsec();
-    }
+    if ( thread != NULL )
+      messageQueue.waitDrained( 2000 ); // try to flush for 2 sec
+  }
+
+	/* hands message to the observer thread, message is left empty */
+
+  void queueMessage( std::string &message )
+  {
+    messageQueue.push( message );
+  }
+
+	/* writes what is queued, returns false if nothing was queued */
+
+  bool writeQueuedMessages()
+  {
+    int num = messageQueue.pop( threadMessages );
+    if ( num == 0 )
+      return false;
+
+    tracedWrite( threadMessages );
+    messageQueue.done( num );
+
+    return true;
   }
 
   static inline void sigHandler( int sig )
@@ -899,19 +918,8 @@ protected:
 
   virtual void threadFunction()
   {
-    usleep( 10*1000 );
-
-    lock();
-    std::vector<std::string> msgs( messages );
-    messages.clear();
-    unlock();
-
-    if ( msgs.size() > 0 )
-      write( msgs );
-
-    lock();
-    isFlushed = (messages.size() != 0);
-    unlock();
+    if ( messageQueue.wait( 100 ) )
+      writeQueuedMessages();
   }
   
   void ThreadFunction()
@@ -930,7 +938,9 @@ protected:
   virtual void startThread()
   { 
     if ( isThreaded && thread == NULL )
+    { exitThread = false;
       thread = new std::thread( runThread, this );  
+    }
   }
   
   virtual void stopThread()
@@ -938,7 +948,9 @@ protected:
       return;
 
     exitThread = true;
+    messageQueue.wake();
     thread->join();
+    writeQueuedMessages();
     delete thread;
     thread = NULL;
   }
@@ -971,6 +983,24 @@ public:
 
 	return std::get<std::string>( *this ); 
       }
+
+      void appendTo( std::string &string ) const
+      {
+	char s[100];
+
+	if ( std::holds_alternative<int64_t>(*this) )
+	  snprintf( s, sizeof(s), "%lld", (long long) std::get<int64_t>( *this ) );
+	else if ( std::holds_alternative<float>(*this) )
+	  snprintf( s, sizeof(s), "%g", std::get<float>( *this ) );
+	else if ( std::holds_alternative<int32_t>(*this) )
+	  snprintf( s, sizeof(s), "%d", std::get<int32_t>( *this ) );
+	else
+        { string += std::get<std::string>( *this );
+	  return;
+	}
+
+	string += s;
+      }
   };
 
   typedef std::function<ObsvValue(const char*alias,bool&hasUpdate,bool&hasStatic,bool&hasDynamic,uint64_t timestamp,ObsvObjects*objects,ObsvObject*object)> ObsvValueGetFunc;
@@ -1215,6 +1245,8 @@ public:
     } );
 
     obsvValueGetInitialized = true;
+
+    resolveSchemes();
   }
 
   ObsvValue getObsvValue( const char *name, bool &hasUpdate, bool &hasStatic, bool &hasDynamic, uint64_t timestamp, ObsvObjects *objects=NULL, ObsvObject *object=NULL )
@@ -1243,17 +1275,102 @@ public:
     return getObsvValue( name, hasUpdate, hasStatic, hasDynamic, timestamp, objects, object );
   }
 
+	// a scheme component like "/pos<id>" is split once into literal and <key>
+	// tokens, the keys are resolved to their getters by resolveSchemes()
+
+  class SchemeToken
+  {
+    public:
+    std::string	     text;		// literal text or key of a <key> placeholder
+    ObsvValueGetter *getter;		// NULL for literals and unknown keys
+    bool	     isKey;
+
+    SchemeToken( const std::string &text, bool isKey )
+      : text  ( text ),
+	getter( NULL ),
+	isKey ( isKey )
+      {}
+  };
+
+  class SchemeComponent : public std::vector<SchemeToken>
+  {
+    public:
+    bool   isNumber;			// the component is a numeric literal
+    double number;
+
+    SchemeComponent( const std::string &component=std::string() )
+      : isNumber( false ),
+	number  ( 0.0 )
+    {
+      size_t pos = 0;
+      size_t start_pos;
+
+      while( (start_pos = component.find( '<', pos )) != std::string::npos )
+      {
+	size_t end_pos = component.find( '>', start_pos+1 );
+	if ( end_pos == std::string::npos )
+	  break;
+
+	if ( start_pos != pos )
+	  emplace_back( component.substr( pos, start_pos-pos ), false );
+	emplace_back( component.substr( start_pos+1, end_pos-1-start_pos ), true );
+
+	pos = end_pos+1;
+      }
+
+      if ( pos < component.length() )
+	emplace_back( component.substr( pos ), false );
+
+      if ( isLiteral() )
+      { char *end;
+	number   = strtod( front().text.c_str(), &end );
+	isNumber = (end != front().text.c_str() && *end == '\0');
+      }
+    }
+
+    bool isValue() const		// a single <key>
+    { return size() == 1 && front().isKey;
+    }
+
+    bool isLiteral() const
+    { return size() == 1 && !front().isKey;
+    }
+  };
+
+  class SchemeOperand
+  {
+    public:
+    std::string	text;
+    double	number;
+    bool	isNumber;
+    bool	isFloat;
+  };
+
   class SchemeMessage 
   {
     public:
     
+    enum ConditionOp
+    {
+      CondAny,
+      CondEqual,
+      CondNotEqual,
+      CondLess,
+      CondLessEqual,
+      CondGreater,
+      CondGreaterEqual
+    };
+
     bool forceUpdate;
-    std::vector<std::string> condition;
-    std::vector<std::string> components;
-    std::function<bool(std::string&,std::string&)> condition_operator;
+    bool hasCondition;
+    ConditionOp conditionOp;
+    SchemeComponent conditionOperands[2];
+    std::vector<SchemeComponent> components;
 
     bool setCondition( std::string &cond )
     {
+      hasCondition = false;
+
       std::vector<std::string> comp( split( cond, ' ' ) );
       if ( comp.size() != 3 )
 	return false;
@@ -1264,31 +1381,74 @@ public:
 	  return false;
       }
 
-      condition = comp;
-
-      if ( condition[1] == "==" )
-	condition_operator = [](std::string &v0,std::string &v1) { return v0 == v1; };
-      else if ( condition[1] == "!=" )
-	condition_operator = [](std::string &v0,std::string &v1) { return v0 != v1; };
-      else if ( condition[1] == "<" )
-	condition_operator = [](std::string &v0,std::string &v1) { return std::stod(v0) < std::stod(v1); };
-      else if ( condition[1] == "<=" )
-	condition_operator = [](std::string &v0,std::string &v1) { return std::stod(v0) <= std::stod(v1); };
-      else if ( condition[1] == ">" )
-	condition_operator = [](std::string &v0,std::string &v1) { return std::stod(v0) > std::stod(v1); };
-      else if ( condition[1] == ">=" )
-	condition_operator = [](std::string &v0,std::string &v1) { return std::stod(v0) >= std::stod(v1); };
+      hasCondition	   = true;
+      conditionOperands[0] = SchemeComponent( comp[0] );
+      conditionOperands[1] = SchemeComponent( comp[2] );
+
+      if ( comp[1] == "==" )
+	conditionOp = CondEqual;
+      else if ( comp[1] == "!=" )
+	conditionOp = CondNotEqual;
+      else if ( comp[1] == "<" )
+	conditionOp = CondLess;
+      else if ( comp[1] == "<=" )
+	conditionOp = CondLessEqual;
+      else if ( comp[1] == ">" )
+	conditionOp = CondGreater;
+      else if ( comp[1] == ">=" )
+	conditionOp = CondGreaterEqual;
       else 
-	condition_operator = [](std::string &v0,std::string &v1) { return true; };
+	conditionOp = CondAny;
 
       return true;
     }
 
-    SchemeMessage( bool forceUpdate=false ) : forceUpdate( forceUpdate ) {}
+    bool compare( const SchemeOperand &v0, const SchemeOperand &v1 ) const
+    {
+      if ( conditionOp == CondAny )
+	return true;
+
+      if ( v0.isNumber && v1.isNumber )
+      {
+	double n0 = v0.number;
+	double n1 = v1.number;
+	if ( v0.isFloat || v1.isFloat )	// compare in the precision of the value
+	{ n0 = (float) n0;
+	  n1 = (float) n1;
+	}
+
+	switch ( conditionOp )
+	{
+	  case CondEqual:        return n0 == n1;
+	  case CondNotEqual:     return n0 != n1;
+	  case CondLess:         return n0 <  n1;
+	  case CondLessEqual:    return n0 <= n1;
+	  case CondGreater:      return n0 >  n1;
+	  case CondGreaterEqual: return n0 >= n1;
+	  default:		 return true;
+	}
+      }
+
+      if ( v0.isNumber != v1.isNumber )
+	return conditionOp == CondNotEqual;
+
+      if ( conditionOp == CondEqual )
+	return v0.text == v1.text;
+      if ( conditionOp == CondNotEqual )
+	return v0.text != v1.text;
+
+      return false;
+    }
+
+    SchemeMessage( bool forceUpdate=false ) : forceUpdate( forceUpdate ), hasCondition( false ), conditionOp( CondAny ) {}
       SchemeMessage( std::string &condition, std::vector<std::string> &components, bool forceUpdate=false )
-	: components ( components ),
-	  forceUpdate( forceUpdate )
-	{ setCondition( condition ); }
+	: forceUpdate ( forceUpdate ),
+	  hasCondition( false ),
+	  conditionOp ( CondAny )
+	{ setCondition( condition );
+	  for ( int i = 0; i < components.size(); ++i )
+	    this->components.emplace_back( components[i] );
+	}
   };
 
   class Scheme : public std::vector<SchemeMessage>
@@ -1300,6 +1460,31 @@ public:
 
   std::map<std::string,Scheme> schemes;
   bool          hasScheme;
+  std::string	schemeBuffer;
+  SchemeOperand schemeOperands[2];
+
+  void resolveScheme( SchemeComponent &component )
+  {
+    for ( int i = 0; i < component.size(); ++i )
+    { SchemeToken &token( component[i] );
+      if ( token.isKey )
+      { ObsvValueGet::iterator iter( obsvValueGet.find( token.text ) );
+	token.getter = (iter == obsvValueGet.end() ? NULL : &iter->second);
+      }
+    }
+  }
+
+  void resolveSchemes()
+  {
+    for ( auto &iter: schemes )
+    { for ( SchemeMessage &message: iter.second )
+      { resolveScheme( message.conditionOperands[0] );
+	resolveScheme( message.conditionOperands[1] );
+	for ( SchemeComponent &component: message.components )
+	  resolveScheme( component );
+      }
+    }
+  }
 
 public:
   
@@ -1360,6 +1545,11 @@ public:
   float						 reportDistance;
   std::string					 statusMsg;
   std::vector<std::string>			 messages;
+  JsonWriter					 jsonWriter;
+  std::unordered_map<const char*,const char*>	 jsonKeys;		// filter key to mapped json key
+  int						 jsonKeysVersion;
+  std::string					 jsonTimestampKey;
+  std::string					 jsonTimestampTemplate;
   std::string					 runMode;
   ObsvUserData 					*userData;
 
@@ -1376,7 +1566,6 @@ public:
     isThreaded    ( false ),
     thread        ( NULL  ),
     exitThread    ( false ),
-    isFlushed     ( false ),
     maxFPS        ( 0.0f  ),
     validDuration ( 5.0f  ),
     aliveTimeout  ( 1.0f  ),
@@ -1395,6 +1584,7 @@ public:
     rectNormalized( false ),
     reportDistance( 0.5 ),
     messages	  (),
+    jsonKeysVersion( -1 ),
     runMode	  (),
     userData	  ( NULL )
   {
@@ -1414,6 +1604,14 @@ public:
   { return rects.rect();
   }
 
+  int queueDepth()
+  { return messageQueue.depth();
+  }
+
+  uint64_t queueDropped()
+  { return messageQueue.numDropped();
+  }
+
   virtual ObsvRect *setRect( float x=-3.0, float y=-3.0, float width=6.0, float height=6.0, ObsvRect::Edge edge=ObsvRect::Edge::EdgeNone, ObsvRect::Shape shape=ObsvRect::Shape::ShapeRect )
   { return rects.set( x, y, width, height, edge, shape );
   }
@@ -1458,49 +1656,91 @@ public:
   }
   
 
-  std::string schemeComponentAsString( std::string &component, bool &hasUpdate, bool &hasStatic, bool &hasDynamic, uint64_t timestamp, ObsvObjects *objects=NULL, ObsvObject *object=NULL )
+  inline ObsvValue schemeValue( SchemeToken &token, bool &hasUpdate, bool &hasStatic, bool &hasDynamic, uint64_t timestamp, ObsvObjects *objects=NULL, ObsvObject *object=NULL )
+  {
+    if ( token.getter == NULL )
+      return ObsvValue( token.text );
+
+    return token.getter->func( token.getter->alias, hasUpdate, hasStatic, hasDynamic, timestamp, objects, object );
+  }
+
+  void renderSchemeComponent( SchemeComponent &component, std::string &result, bool &hasUpdate, bool &hasStatic, bool &hasDynamic, uint64_t timestamp, ObsvObjects *objects=NULL, ObsvObject *object=NULL )
+  {
+    for ( int i = 0; i < component.size(); ++i )
+    { SchemeToken &token( component[i] );
+      if ( token.isKey )
+	schemeValue( token, hasUpdate, hasStatic, hasDynamic, timestamp, objects, object ).appendTo( result );
+      else
+	result += token.text;
+    }
+  }
+
+  std::string schemeComponentAsString( SchemeComponent &component, bool &hasUpdate, bool &hasStatic, bool &hasDynamic, uint64_t timestamp, ObsvObjects *objects=NULL, ObsvObject *object=NULL )
   {
     std::string result;
-    size_t pos = 0;
-    size_t start_pos;
+    renderSchemeComponent( component, result, hasUpdate, hasStatic, hasDynamic, timestamp, objects, object );
+    return result;
+  }
 
-    while( (start_pos = component.find( '<', pos )) != std::string::npos )
+  void evalSchemeOperand( SchemeComponent &component, SchemeOperand &operand, bool &hasUpdate, bool &hasStatic, bool &hasDynamic, uint64_t timestamp, ObsvObjects *objects=NULL, ObsvObject *object=NULL )
+  {
+    operand.isFloat = false;
+
+    if ( component.isLiteral() )
+    { operand.text     = component.front().text;
+      operand.number   = component.number;
+      operand.isNumber = component.isNumber;
+      return;
+    }
+
+    operand.text.clear();
+
+    if ( component.isValue() )
     {
-      if ( start_pos != pos )
-	result += component.substr( pos, start_pos-pos);
+      ObsvValue value( schemeValue( component.front(), hasUpdate, hasStatic, hasDynamic, timestamp, objects, object ) );
 
-      size_t end_pos = component.find( '>', start_pos+1 );
+      operand.isNumber = true;
 
-      if ( end_pos != std::string::npos )
-      { std::string key( component.substr(start_pos+1,end_pos-1-start_pos) );
-	result += valueAsString( key, hasUpdate, hasStatic, hasDynamic, timestamp, objects, object );
+      if ( std::holds_alternative<float>(value) )
+      { operand.number  = std::get<float>( value );
+	operand.isFloat = true;
+	return;
+      }
+      if ( std::holds_alternative<int32_t>(value) )
+      { operand.number = std::get<int32_t>( value );
+	return;
+      }
+      if ( std::holds_alternative<int64_t>(value) )
+      { operand.number = std::get<int64_t>( value );
+	return;
       }
-      pos = end_pos+1;
-    }
 
-    if ( pos < component.length() )
-      result += component.substr( pos, component.length()-pos );
+      operand.text = std::get<std::string>( value );
+    }
+    else
+      renderSchemeComponent( component, operand.text, hasUpdate, hasStatic, hasDynamic, timestamp, objects, object );
 
-    return result;
+    char *end;
+    operand.number   = strtod( operand.text.c_str(), &end );
+    operand.isNumber = (end != operand.text.c_str() && *end == '\0');
   }
 
   virtual bool schemeCondition( SchemeMessage &schemeMessage, uint64_t timestamp, ObsvObjects *objects=NULL, ObsvObject *object=NULL )
   {
-    std::vector<std::string> &condition( schemeMessage.condition );
-    if ( condition.size() != 3 )
+    if ( !schemeMessage.hasCondition )
       return true;
 
     bool hasUpdate  = false;
     bool hasStatic  = false;
     bool hasDynamic = false;
-    std::string v0( schemeComponentAsString( condition[0], hasUpdate, hasStatic, hasDynamic, timestamp, objects, object ) );
+    evalSchemeOperand( schemeMessage.conditionOperands[0], schemeOperands[0], hasUpdate, hasStatic, hasDynamic, timestamp, objects, object );
 
     if( !(hasUpdate || (hasStatic&&!hasDynamic)))
       return false;
 
-    std::string v1( schemeComponentAsString( condition[2], hasUpdate, hasStatic, hasDynamic, timestamp, objects, object ) );
+    evalSchemeOperand( schemeMessage.conditionOperands[1], schemeOperands[1], hasUpdate, hasStatic, hasDynamic, timestamp, objects, object );
 
-    return (hasUpdate || (hasStatic&&!hasDynamic)) && schemeMessage.condition_operator( v0, v1 );
+    return (hasUpdate || (hasStatic&&!hasDynamic)) && schemeMessage.compare( schemeOperands[0], schemeOperands[1] );
   }
 
   virtual bool setScheme( std::string scheme, bool fromFile=false )
@@ -1586,6 +1826,9 @@ public:
 
     hasScheme = (schemes.size() != 0);
 
+    if ( obsvValueGetInitialized )
+      resolveSchemes();
+
     return hasScheme;
   }
   
@@ -1616,6 +1859,15 @@ public:
     descr.get( "aliveTimeout",     aliveTimeout );
     descr.get( "smoothing",        smoothing   );
     descr.get( "isThreaded",       isThreaded  );
+
+    int queueSize;
+    if ( descr.get( "queueSize", queueSize ) )
+      messageQueue.setCapacity( queueSize );
+
+    std::string queuePolicy;
+    if ( descr.get( "queuePolicy", queuePolicy ) )
+      messageQueue.setPolicy( MessageQueue::policyByName( queuePolicy ) );
+
     descr.get( "showSwitchStatus", showSwitchStatus  );
     descr.get( "showCountStatus",  showCountStatus  );
     descr.get( "runMode",          runMode  );
@@ -1827,36 +2079,35 @@ public:
     {
       if ( schemeCondition( scheme[i], timestamp, objects, object ) )
       {
-	std::string msg;
+	std::string &msg( schemeBuffer );
 	bool hasUpdate  = false;
 	bool hasStatic  = false;
 	bool hasDynamic = false;
 
-	std::vector<std::string> &components( scheme[i].components );
+	msg.clear();
+
+	std::vector<SchemeComponent> &components( scheme[i].components );
 	for ( int c = 0; c < components.size(); ++c )
         { 
-	  std::string result( schemeComponentAsString( components[c], hasUpdate, hasStatic, hasDynamic, timestamp, objects, object ) );
+	  size_t length = msg.length();
+	  if ( length > 0 )
+	    msg += " ";
 
-	  //	  printf( "has(%s) %d\n", components[c].c_str(), hasUpdate );
-	  if ( !result.empty() )
-	  { if ( !msg.empty() )
-	      msg += " ";
-	    msg += result;
-	  }
+	  size_t start = msg.length();
+	  renderSchemeComponent( components[c], msg, hasUpdate, hasStatic, hasDynamic, timestamp, objects, object );
+
+	  if ( msg.length() == start )	// component was empty, drop the separator
+	    msg.resize( length );
 	}
 
 	if ( hasUpdate || (hasStatic&&!hasDynamic) || scheme[i].forceUpdate )
 	{
 	  if ( thread != NULL )
-          { lock();
-	    messages.push_back( msg );
-	    unlock();
-	  }
+	    queueMessage( msg );
 	  else
           { messages.push_back( msg );
-	    write( messages );
+	    tracedWrite( messages );
 	    messages.clear();
-	    isFlushed = true;
 	  }
 	}
       }
@@ -1917,48 +2168,88 @@ public:
       reportJsonMessages();
   }
 
-  virtual void writeJsonMsg( std::string msg, uint64_t timestamp )
+	/* the mapped key of a filter key, kmc() runs the key templates each time */
+
+  const char *jsonKey( const char *key )
   {
-    std::string message( "{" );
-    
-    if ( obsvFilter.filterEnabled( Filter::TIMESTAMP ) )
-    {
-      if ( timestamp == (uint64_t)0 )
-	timestamp = this->timestamp;
-      
-      std::string kmcTimestamp( obsvFilter.kmc(Filter::ObsvTimestamp) );
-      const char *templ = NULL;
+    if ( jsonKeysVersion != obsvFilter.version )
+    { jsonKeys.clear();
+      jsonTimestampKey.clear();
+      jsonKeysVersion = obsvFilter.version;
+    }
+
+    std::unordered_map<const char*,const char*>::iterator iter( jsonKeys.find( key ) );
+    if ( iter != jsonKeys.end() )
+      return iter->second;
+
+    const char *mapped = obsvFilter.kmc( key );
+    jsonKeys.emplace( key, mapped );
+
+    return mapped;
+  }
 
-      char *column = (char *) strchr( kmcTimestamp.c_str(), '@' );
-      if ( column != NULL )
-      { templ = &column[1];
-	column[0] = '\0';
+	/* starts a message in json with the timestamp as first member */
+
+  void beginJsonMsg( JsonWriter &json, uint64_t timestamp )
+  {
+    json.clear();
+    json.beginObject();
+
+    if ( !obsvFilter.filterEnabled( Filter::TIMESTAMP ) )
+      return;
+
+    if ( timestamp == (uint64_t)0 )
+      timestamp = this->timestamp;
+      
+    jsonKey( Filter::ObsvTimestamp );	// validates the cached timestamp key
+
+    if ( jsonTimestampKey.empty() )
+    { jsonTimestampKey = obsvFilter.km( Filter::ObsvTimestamp );	// key@template
+      size_t column = jsonTimestampKey.find( '@' );
+      jsonTimestampTemplate.clear();
+      if ( column != std::string::npos )
+      { jsonTimestampTemplate = jsonTimestampKey.substr( column+1 );
+	jsonTimestampKey.resize( column );
       }
-      message += "\"";
-      message += kmcTimestamp.c_str();
-      message += "\":";
-      message += timestampString( templ, timestamp );
-      if ( !msg.empty() )
-	message += ",";
     }
-    
-    message += msg;
-    message += "}";
-    
+
+    json.key( jsonTimestampKey.c_str() );
+
+    if ( jsonTimestampTemplate.find( '%' ) == std::string::npos )
+      json.valueUInt( timestamp );
+    else
+      json.raw( timestampString( jsonTimestampTemplate.c_str(), timestamp ) );
+  }
+
+	/* closes the message in json and hands it to the writer */
+
+  void writeJsonMsg( JsonWriter &json )
+  {
+    json.endObject();
+
     if ( thread != NULL )
-    {
-      lock();
-      messages.push_back( message );
-      unlock();
-    }
+      queueMessage( json.buffer );
     else
-    { messages.push_back( message );
-      write( messages );
+    { messages.emplace_back();
+      messages.back().swap( json.buffer );
+      tracedWrite( messages );
+      json.buffer.swap( messages.back() );	// keep the capacity for the next message
       messages.clear();
-      isFlushed = true;
     }
   }
 
+  virtual void writeJsonMsg( std::string msg, uint64_t timestamp )
+  {
+    beginJsonMsg( jsonWriter, timestamp );
+
+    if ( !msg.empty() )
+    { jsonWriter.separator();
+      jsonWriter.raw( msg );
+    }
+
+    writeJsonMsg( jsonWriter );
+  }
+
   inline bool hasReportObjects() const
   { 
     return obsvFilter.filterEnabled( Filter::OBSV_MOVE  )      ||
@@ -1993,61 +2284,51 @@ public:
     msg += "\"" + key + "\":\"" + value + "\"";
   }
   
-  virtual void bracket( std::string &msg )
+  virtual bool reportJsonCountMessages( JsonWriter &json, ObsvObjects &objects )
   {
-    if ( !msg.empty() )
-    { std::string m( "{" );
-      m +=  msg;
-      m += "}";
-      msg = m;
-    }
-  }
-
-  virtual std::string reportJsonCountMessages( ObsvObjects &objects )
-  {
-    std::string msg;
+    size_t start = json.size();
 
     if ( obsvFilter.filterEnabled( Filter::OBSV_COUNT ) )
     { if ( continuous || objects.lastCount != (int)objects.validCount )
-	setJsonInt( msg, obsvFilter.kmc(Filter::ObsvCount), (int)objects.validCount );
+	json.setInt( jsonKey(Filter::ObsvCount), (int)objects.validCount );
     }
     if ( obsvFilter.filterEnabled( Filter::OBSV_SWITCH ) )
     { if ( continuous || ((bool)objects.lastCount) != (bool)objects.validCount )
-	setJsonInt( msg, obsvFilter.kmc(Filter::ObsvSwitch), (int)(bool)objects.validCount );
+	json.setInt( jsonKey(Filter::ObsvSwitch), (int)(bool)objects.validCount );
     }
     if ( obsvFilter.filterEnabled( Filter::OBSV_SWITCH_DURATION ) )
     {
       if ( objects.lastCount > 0 && objects.switch_timestamp != 0 && (objects.validCount == 0 || continuous) )
-	setJsonInt( msg, obsvFilter.kmc(Filter::ObsvSwitchDuration), (int)(objects.timestamp-objects.switch_timestamp) );
+	json.setInt( jsonKey(Filter::ObsvSwitchDuration), (int)(objects.timestamp-objects.switch_timestamp) );
       else if ( continuous )
-	setJsonInt( msg, obsvFilter.kmc(Filter::ObsvSwitchDuration), (int)0 );
+	json.setInt( jsonKey(Filter::ObsvSwitchDuration), (int)0 );
     }
     if ( obsvFilter.filterEnabled( Filter::OBSV_ALIVE ) )
     { if ( objects.alive )
-	setJsonInt( msg, obsvFilter.kmc(Filter::ObsvAlive), (int)(bool)objects.alive );
+	json.setInt( jsonKey(Filter::ObsvAlive), (int)(bool)objects.alive );
     }
     if ( obsvFilter.filterEnabled( Filter::OBSV_OPERATIONAL ) )
     { if ( objects.alive )
-	setJsonFloat( msg, obsvFilter.kmc(Filter::ObsvOperational), (int)(bool)objects.operational );
+	json.setFloat( jsonKey(Filter::ObsvOperational), (int)(bool)objects.operational );
     }
     if ( obsvFilter.filterEnabled( Filter::OBSV_ENTERCOUNT ) )
     { if ( continuous || objects.lastEnterCount != (int)objects.enterCount )
-	setJsonInt( msg, obsvFilter.kmc(Filter::ObsvEnterCount), (int)objects.enterCount );
+	json.setInt( jsonKey(Filter::ObsvEnterCount), (int)objects.enterCount );
     }
     if ( obsvFilter.filterEnabled( Filter::OBSV_LEAVECOUNT ) )
     { if ( continuous || objects.lastLeaveCount != (int)objects.leaveCount )
-	setJsonInt( msg, obsvFilter.kmc(Filter::ObsvLeaveCount), (int)objects.leaveCount );
+	json.setInt( jsonKey(Filter::ObsvLeaveCount), (int)objects.leaveCount );
     }
     if ( obsvFilter.filterEnabled( Filter::OBSV_GATECOUNT ) )
     { if ( continuous || objects.lastGateCount != (int)objects.gateCount )
-	setJsonInt( msg, obsvFilter.kmc(Filter::ObsvGateCount), (int)objects.gateCount );
+	json.setInt( jsonKey(Filter::ObsvGateCount), (int)objects.gateCount );
     }
     if ( obsvFilter.filterEnabled( Filter::OBSV_AVGLIFESPAN ) )
     { if ( continuous || objects.lastAvgLifespan != (int)objects.avgLifespan )
-	setJsonInt( msg, obsvFilter.kmc(Filter::ObsvAvgLifeSpan), (int)objects.avgLifespan );
+	json.setInt( jsonKey(Filter::ObsvAvgLifeSpan), (int)objects.avgLifespan );
     }
 
-    return msg;
+    return json.size() != start;
   }
   
   virtual std::string reportJsonStartMessage()
@@ -2136,10 +2417,8 @@ public:
     return false;
   }
   
-  virtual std::string reportJsonMessage( ObsvObjects &objects, ObsvObject &object )
+  virtual bool reportJsonMessage( JsonWriter &json, ObsvObjects &objects, ObsvObject &object )
   {
-    std::string msg;
-
     bool enterEnabled      = obsvFilter.filterEnabled( Filter::OBSV_ENTER );
     bool moveEnabled       = obsvFilter.filterEnabled( Filter::OBSV_MOVE  );
     bool leaveEnabled      = obsvFilter.filterEnabled( Filter::OBSV_LEAVE );
@@ -2162,164 +2441,164 @@ public:
     bool reportAny = (reportEnter || reportMove || reportLeave || reportEnterEdge || reportLeaveEdge);
     
     if ( !reportAny )
-      return msg;
+      return false;
     
     object.moveDone();
 
+    size_t start  = json.size();
+    bool   nested = obsvFilter.filterEnabled( Filter::OBSV_OBJECT );
+
+    if ( nested )
+    { json.key( jsonKey(Filter::ObsvObject) );
+      json.beginObject();
+    }
+
+    size_t fields = json.size();
+
     if ( obsvFilter.filterEnabled( Filter::OBSV_TYPE ) )
     { if ( reportEnter )
-	setJsonString( msg, obsvFilter.kmc(Filter::ObsvType), obsvFilter.kmc(Filter::ObsvEnter) );
+	json.setString( jsonKey(Filter::ObsvType), jsonKey(Filter::ObsvEnter) );
       if ( reportMove  )
-	setJsonString( msg, obsvFilter.kmc(Filter::ObsvType), obsvFilter.kmc(Filter::ObsvMove) );
+	json.setString( jsonKey(Filter::ObsvType), jsonKey(Filter::ObsvMove) );
       if ( reportLeave )
-	setJsonString( msg, obsvFilter.kmc(Filter::ObsvType), obsvFilter.kmc(Filter::ObsvLeave) );
+	json.setString( jsonKey(Filter::ObsvType), jsonKey(Filter::ObsvLeave) );
     }
 
     if ( reportEnterEdge )
-      setJsonString( msg, obsvFilter.kmc(Filter::ObsvEnterEdge), object.edgeAsString() );
+      json.setString( jsonKey(Filter::ObsvEnterEdge), object.edgeAsString() );
     if ( reportLeaveEdge )
-      setJsonString( msg, obsvFilter.kmc(Filter::ObsvLeaveEdge), object.edgeAsString() );
+      json.setString( jsonKey(Filter::ObsvLeaveEdge), object.edgeAsString() );
 
     if ( !fullFrame )
     { if ( obsvFilter.filterEnabled( Filter::FRAME_ID ) )
-	setJsonInt( msg, obsvFilter.kmc(Filter::FrameId), frame_id );
+	json.setInt( jsonKey(Filter::FrameId), frame_id );
       if ( (obsvFilter.filterEnabled( Filter::OBSV_REGIONS ) || obsvFilter.filterEnabled( Filter::OBSV_REGION )) && !objects.region.empty() )
-	setJsonString( msg, obsvFilter.kmc(Filter::ObsvRegion), objects.region );
+	json.setString( jsonKey(Filter::ObsvRegion), objects.region );
     }
     
     if ( reportLeave && obsvFilter.filterEnabled( Filter::OBSV_LIFESPAN ) )
-      setJsonInt( msg, obsvFilter.kmc(Filter::ObsvLifeSpan), object.timestamp_touched - object.timestamp_enter );
+      json.setInt( jsonKey(Filter::ObsvLifeSpan), object.timestamp_touched - object.timestamp_enter );
 
     if ( obsvFilter.filterEnabled( Filter::OBSV_ID ) )
-      setJsonInt( msg, obsvFilter.kmc(Filter::ObsvId), object.id );
+      json.setInt( jsonKey(Filter::ObsvId), object.id );
 
     if ( obsvFilter.filterEnabled( Filter::OBSV_UUID ) )
-      setJsonString( msg, obsvFilter.kmc(Filter::ObsvUUID), object.uuid.str() );
+      json.setString( jsonKey(Filter::ObsvUUID), object.uuid.str() );
 
     if ( obsvFilter.filterEnabled( Filter::OBSV_X ) )
-      setJsonFloat( msg, obsvFilter.kmc(Filter::ObsvX), (object.x-objects.centerX) * objects.scaleX );
+      json.setFloat( jsonKey(Filter::ObsvX), (object.x-objects.centerX) * objects.scaleX );
     if ( obsvFilter.filterEnabled( Filter::OBSV_Y ) )
-      setJsonFloat( msg, obsvFilter.kmc(Filter::ObsvY), (object.y-objects.centerY) * objects.scaleY );
+      json.setFloat( jsonKey(Filter::ObsvY), (object.y-objects.centerY) * objects.scaleY );
     if ( obsvFilter.filterEnabled( Filter::OBSV_Z ) && !isnan(object.z) )
-      setJsonFloat( msg, obsvFilter.kmc(Filter::ObsvZ), (object.z-objects.centerZ) * objects.scaleZ );
+      json.setFloat( jsonKey(Filter::ObsvZ), (object.z-objects.centerZ) * objects.scaleZ );
 
     if ( obsvFilter.filterEnabled( Filter::OBSV_SIZE ) && !isnan(object.size) )
-      setJsonFloat( msg, obsvFilter.kmc(Filter::ObsvSize), object.size );
+      json.setFloat( jsonKey(Filter::ObsvSize), object.size );
 
-    if ( !msg.empty() && obsvFilter.filterEnabled( Filter::OBSV_OBJECT ) )
-    { std::string m;
-      m +=  "\"" + std::string(obsvFilter.kmc(Filter::ObsvObject)) + "\":{";
-      m +=  msg;
-      m += "}";
-      msg = m;
+    if ( json.size() == fields )
+    { json.truncate( start );
+      return false;
     }
+
+    if ( nested )
+      json.endObject();
     
-    return msg;
+    return true;
   }
 
-  virtual std::string reportJsonMessageObjects( ObsvObjects &objects )
+  virtual bool reportJsonMessageObjects( JsonWriter &json, ObsvObjects &objects )
   {
-    bool reportRegions = (rects.numRects() > 1 || obsvFilter.filterEnabled( Filter::OBSV_REGIONS ) || obsvFilter.filterEnabled( Filter::OBSV_REGION ));
-      
-    std::string msg, objectsMsg;
-	
-    if ( hasReportObjects() )
-    {
-      for ( auto &iter: objects )
-      { std::string m( reportJsonMessage( objects, iter.second ) );
-	if ( !m.empty() )
-	{ bracket( m );
-	  checkJsonEmpty( objectsMsg );
-	  objectsMsg += m;
-	}
-      }
-    }
+    bool reportRegions = (rects.numRects() > 1 || obsvFilter.filterEnabled( Filter::OBSV_REGIONS ));
+    size_t start       = json.size();
 
-    if ( !objectsMsg.empty() || fullFrame )
-    { 
-      std::string m( "\"" );
-      m += obsvFilter.kmc(Filter::ObsvObjects);
-      m += "\":[";
-      m +=  objectsMsg;
-      m += "]";
-      objectsMsg = m;
+    if ( reportRegions )
+    { json.beginObject();
+      json.setString( jsonKey(Filter::ObsvRegion), objects.region );
     }
+    else if ( obsvFilter.filterEnabled( Filter::OBSV_REGION ) )
+      json.setString( jsonKey(Filter::ObsvRegion), objects.region );
+
+    bool hasMsg = reportJsonCountMessages( json, objects );
+	
+    bool reportObjects = hasReportObjects();
 
-    std::string countMsg( reportJsonCountMessages( objects ) );
+    if ( reportObjects || fullFrame )
+    {
+      size_t arrayStart = json.size();
 
-    if ( objectsMsg.empty() && countMsg.empty() )
-      return msg;
+      json.key( jsonKey(Filter::ObsvObjects) );
+      json.beginArray();
 
-    if ( !countMsg.empty() )
-      msg = countMsg;
+      size_t first = json.size();
 
-    if ( !objectsMsg.empty() )
-    { checkJsonEmpty( msg );
-      msg += objectsMsg;
-    }
+      if ( reportObjects )
+      { for ( auto &iter: objects )
+	{ size_t objectStart = json.size();
+	  json.beginObject();
+	  if ( reportJsonMessage( json, objects, iter.second ) )
+	    json.endObject();
+	  else
+	    json.truncate( objectStart );
+	}
+      }
 
-    if ( rects.numRects() > 1 || obsvFilter.filterEnabled( Filter::OBSV_REGIONS ) )
-    { 
-      std::string m( "{" );
-      setJsonString( m, obsvFilter.kmc(Filter::ObsvRegion), objects.region );
-      checkJsonEmpty( m );
-      m += msg;
-      msg = m + "}";
+      if ( json.size() == first && !fullFrame )
+	json.truncate( arrayStart );
+      else
+      { json.endArray();
+	hasMsg = true;
+      }
     }
-    else if ( obsvFilter.filterEnabled( Filter::OBSV_REGION ) )
-    {
-      std::string m;
-      setJsonString( m, obsvFilter.kmc(Filter::ObsvRegion), objects.region );
-      checkJsonEmpty( m );
-      msg = m + msg;
+
+    if ( !hasMsg )
+    { json.truncate( start );
+      return false;
     }
+
+    if ( reportRegions )
+      json.endObject();
     
-    return msg;
+    return true;
   }
     
   virtual void reportJsonMessagesFullFrame()
   {
-    std::string regionsMsg;
+    JsonWriter &json( jsonWriter );
+
+    beginJsonMsg( json, timestamp );
+
+    if ( obsvFilter.filterEnabled( Filter::FRAME_ID ) )
+      json.setInt( jsonKey(Filter::FrameId), frame_id );
+
+    bool   reportRegions = (rects.numRects() > 1 || obsvFilter.filterEnabled( Filter::OBSV_REGIONS ));
+    size_t regionsStart  = json.size();
+
+    if ( reportRegions )
+    { json.key( jsonKey(Filter::ObsvRegions) );
+      json.beginArray();
+    }
+
+    size_t first = json.size();
 
     for ( int i = rects.numRects()-1; i >= 0; --i )
     {
       ObsvObjects &objects( rects.rect(i).objects );
 
       if ( continuous || hasMovedObject( objects ) )
-      {
-	std::string objectsMsg( reportJsonMessageObjects( objects ) );
-	if ( !objectsMsg.empty() )
-	{ checkJsonEmpty( regionsMsg );
-	  regionsMsg += objectsMsg;
-	}
-      }
+	reportJsonMessageObjects( json, objects );
     }
     
-    if ( !regionsMsg.empty() )
-    {
-      if ( rects.numRects() > 1 || obsvFilter.filterEnabled( Filter::OBSV_REGIONS ) )
-      { 
-	std::string m( "\"" );
-	m += obsvFilter.kmc(Filter::ObsvRegions);
-	m += "\":[";
-	m +=  regionsMsg;
-	m += "]";
-	regionsMsg = m;
-      }
-    }
+    bool hasRegions = (json.size() != first);
 
-    std::string msg;
-
-    if ( (continuous || !regionsMsg.empty()) && obsvFilter.filterEnabled( Filter::FRAME_ID ) )
-      setJsonInt( msg, obsvFilter.kmc(Filter::FrameId), frame_id );
-    
-    if ( !regionsMsg.empty() )
-    { checkJsonEmpty( msg );
-      msg += regionsMsg;
+    if ( !hasRegions )
+    { if ( !continuous )
+	return;
+      json.truncate( regionsStart );
     }
+    else if ( reportRegions )
+      json.endArray();
 
-    if ( continuous || !msg.empty() )
-      writeJsonMsg( msg, timestamp );
+    writeJsonMsg( json );
   }
 
   virtual void reportJsonMessages()
@@ -2328,6 +2607,8 @@ public:
       reportJsonMessagesFullFrame();
     else
     {
+      JsonWriter &json( jsonWriter );
+
       bool reportObjects = hasReportObjects();
       bool reportRegions = (obsvFilter.filterEnabled( Filter::OBSV_REGIONS ) || obsvFilter.filterEnabled( Filter::OBSV_REGION ));
 
@@ -2335,20 +2616,20 @@ public:
       {
 	ObsvObjects &objects( rects.rect(i).objects );
 
-	std::string msg( reportJsonCountMessages( objects ) );
-	if ( !msg.empty() )
+	beginJsonMsg( json, objects.timestamp );
+	if ( reportJsonCountMessages( json, objects ) )
         { if ( obsvFilter.filterEnabled( Filter::FRAME_ID ) )
-	    setJsonInt( msg, obsvFilter.kmc(Filter::FrameId), frame_id );
+	    json.setInt( jsonKey(Filter::FrameId), frame_id );
 	  if ( reportRegions && !objects.region.empty() )
-	    setJsonString( msg, obsvFilter.kmc(Filter::ObsvRegion), objects.region );
-	  writeJsonMsg( msg, objects.timestamp );
+	    json.setString( jsonKey(Filter::ObsvRegion), objects.region );
+	  writeJsonMsg( json );
 	}
 
 	if ( reportObjects )
         { for ( auto &iter: objects )
-	  { std::string msg( reportJsonMessage( objects, iter.second ) );
-	    if ( !msg.empty() )
-	      writeJsonMsg( msg, iter.second.timestamp );
+	  { beginJsonMsg( json, iter.second.timestamp );
+	    if ( reportJsonMessage( json, objects, iter.second ) )
+	      writeJsonMsg( json );
 	  }
 	}
       }
@@ -2359,6 +2640,11 @@ public:
   {
   }
 
+  void tracedWrite( std::vector<std::string> &messages, uint64_t timestamp=0 )
+  { LatencyTracer::Scope scope( LatencyTracer::Write );
+    write( messages, timestamp );
+  }
+
   virtual bool stall( uint64_t timestamp=0 )
   {
     if ( isStalled == 1 )
@@ -39,12 +39,28 @@ public:
     fullFrame      = true;
     port           = port;
     isThreaded     = true;
+    maxPending     = 16;
+    maxBacklog     = 1024;
   }
 
   ~WebSocketObserver()
   {
   }
 
+  virtual void setParam( KeyValueMap &descr )
+  {
+    TrackableObserver::setParam( descr );
+
+    descr.get( "maxPending", maxPending );
+    descr.get( "maxBacklog", maxBacklog );
+  }
+
+	/* only full frames supersede each other, enter/move/leave events must all arrive */
+
+  bool canConflate()
+  { return fullFrame;
+  }
+
   int numConnections()
   {
     lock();
@@ -70,6 +86,8 @@ public:
     error( "WebSocketObserver(%s,%s) Error: %s", name.c_str(), getValue( socketID, "remoteIP" ).c_str(), message.c_str() );
   }
 
+	/* each message is moved into a frame once and shared by all connections */
+
   void write( std::vector<std::string> &msgs, uint64_t timestamp=0 )
   {
     if ( numConnections() == 0 )
@@ -82,7 +100,7 @@ public:
       if ( verbose )
 	info( "WebSocketObserver(%s) send: %s", name.c_str(), message.c_str() );
 
-      broadcast( message.c_str(), message.length() );
+      broadcast( newFrame( std::move( message ) ) );
     }
   }
   
@@ -100,12 +118,13 @@ class TrackableWebSocketObserver : public WebSocketObserver
   void threadFunction()
   {
     lock();
-    int timeout = (messages.size() == 0);
+    int timeout = 1;
     if ( connections.size() == 0 )
       timeout = 10;
     unlock();
     
-    TrackableObserver::threadFunction();
+    if ( writeQueuedMessages() )
+      timeout = 0;
 
     wait( timeout );
   }
@@ -219,34 +238,43 @@ public:
 
 class TrackablePackedWebSocketObserver : public WebSocketObserver, PackedTrackable::Stream
 {
-  std::vector<std::vector<uint8_t>> msgs;
-  std::vector<uint8_t> msg;
+  std::string	       msg;		// serialized in place, swapped into the message queue
+
+  bool				delta;			// send key and delta frames instead of full frames
+  PackedTrackable::DeltaEncoder	deltaEncoder;
+  std::atomic<bool>		keyFrameRequested;
 
   void threadFunction()
   {
     lock();
-
-    int timeout = (msgs.size() == 0);
+    int timeout = 1;
     if ( connections.size() == 0 )
       timeout = 10;
- 
-    if ( msgs.size() > 0 )
-    { 
-      for ( int i = 0; i < msgs.size(); ++i )
-	broadcast( (const char *)&msgs[i][0], msgs[i].size() );
-      
-      msgs.resize( 0 );
-    }
-
     unlock();
+ 
+    if ( writeQueuedMessages() )
+      timeout = 0;
 
     wait( timeout );
   }
+
+	/* binary frames, moved into a frame once and shared by all connections */
+
+  void write( std::vector<std::string> &msgs, uint64_t timestamp=0 )
+  {
+    if ( numConnections() == 0 )
+      return;
+
+    for ( int i = 0; i < msgs.size(); ++i )
+      broadcast( newFrame( std::move( msgs[i] ) ) );
+  }
   
 public:
   
   TrackablePackedWebSocketObserver( int port=5000 )
-  : WebSocketObserver( port )
+  : WebSocketObserver( port ),
+    delta            ( false ),
+    keyFrameRequested( false )
   {
     _binary        = true;
     type 	   = PackedWebSocket;
@@ -263,18 +291,25 @@ public:
   ~TrackablePackedWebSocketObserver()
   {
   }
+
+  void setParam( KeyValueMap &descr )
+  {
+    WebSocketObserver::setParam( descr );
+
+    descr.get( "delta",            delta );
+    descr.get( "keyFrameInterval", deltaEncoder.keyFrameInterval );
+  }
   
   bool flushMsg()
   { 
     if ( verbose )
       printf( "TrackablePackedWebSocketObserver(%s) send: %ld bytes\n", name.c_str(), msg.size() );
 
-    lock();
-    
-    msgs.push_back( msg );
-    msg.resize( 0 );
-    
-    unlock();
+    uint64_t dropped = queueDropped();
+    queueMessage( msg );
+
+    if ( queueDropped() != dropped )	// a dropped delta frame breaks the chain
+      keyFrameRequested = true;
 
     return true;
   }
@@ -285,10 +320,7 @@ public:
 
   virtual bool write( const unsigned char *buffer, int size )
   { 
-    int oldSize = msg.size();
-    
-    msg.resize( oldSize + size );
-    memcpy( &msg[oldSize], buffer, size );
+    msg.append( (const char *)buffer, size );
 
     return true;
   }
@@ -306,6 +338,8 @@ public:
     if ( !reporting || numConnections() == 0 )
       return true;
     
+    deltaEncoder.reset();
+
     PackedTrackable::Header header( timestamp, PackedTrackable::StartHeader );
     put( header );
 
@@ -398,7 +432,13 @@ public:
       }
     }
 
-    put( frame );
+    if ( delta )
+    { if ( keyFrameRequested.exchange( false ) )
+	deltaEncoder.reset();
+      deltaEncoder.encode( frame, msg );
+    }
+    else
+      put( frame );
     
     return flushMsg();
   }
@@ -408,6 +448,14 @@ public:
     if ( verbose )
       printf( "TrackableWebSocketObserver(%s,%s) onMessage: %s\n", name.c_str(), getValue( socketID, "remoteIP" ).c_str(), data.c_str() );
 
+  }
+
+	/* the client skipped delta frames, it can only resume with a key frame */
+
+  void onConflate( int socketID )
+  {
+    if ( delta )
+      keyFrameRequested = true;
   }
   
   void onConnect( int socketID )
@@ -416,6 +464,8 @@ public:
     if ( verbose )
       printf( "TrackableWebSocketObserver(%s) New connection from %s\n", name.c_str(), getValue( socketID, "remoteIP" ).c_str() );
 
+    keyFrameRequested = true;
+
     if ( isStarted > 0 )
     {
       PackedTrackable::Header header( timestamp, PackedTrackable::StartHeader ); 
@@ -0,0 +1,105 @@
+// Copyright (c) 2023 ZKM | Hertz-Lab (http://www.zkm.de)
+// Bernd Lintermann <bernd.lintermann@zkm.de>
+//
+// BSD Simplified License.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE" in this distribution.
+//
+
+#ifndef _PV_BLOCK_POOL_H
+#define _PV_BLOCK_POOL_H
+
+#include <stddef.h>
+#include <new>
+#include <mutex>
+#include <vector>
+
+/***************************************************************************
+*** 
+*** BlockPool
+***
+****************************************************************************/
+
+// free list of fixed size memory blocks, one pool per block size. Blocks
+// may be released from any thread, e.g. when a painter drops the last
+// reference to a trackable
+
+template<size_t Size> class BlockPool
+{
+public:
+  static const int maxFree = 8192;
+
+  std::mutex		mutex;
+  std::vector<void*>	freeBlocks;
+
+  ~BlockPool()
+  { for ( int i = 0; i < freeBlocks.size(); ++i )
+      ::operator delete( freeBlocks[i] );
+  }
+
+  void *acquire()
+  {
+    { std::lock_guard<std::mutex> guard( mutex );
+      if ( freeBlocks.size() > 0 )
+      { void *block = freeBlocks.back();
+	freeBlocks.pop_back();
+	return block;
+      }
+    }
+    return ::operator new( Size );
+  }
+
+  void release( void *block )
+  {
+    { std::lock_guard<std::mutex> guard( mutex );
+      if ( freeBlocks.size() < maxFree )
+      { freeBlocks.push_back( block );
+	return;
+      }
+    }
+    ::operator delete( block );
+  }
+
+	// never destroyed, trackables may still be released from atexit handlers
+  static BlockPool &shared()
+  { static BlockPool *pool = new BlockPool;
+    return *pool;
+  }
+};
+
+/***************************************************************************
+*** 
+*** PoolAllocator
+***
+****************************************************************************/
+
+// allocator for std::allocate_shared, object and reference count end up in
+// one pooled block
+
+template<typename T> class PoolAllocator
+{
+public:
+  typedef T value_type;
+
+  PoolAllocator() {}
+  template<typename U> PoolAllocator( const PoolAllocator<U> & ) {}
+
+  T *allocate( size_t n )
+  { if ( n != 1 )
+      return static_cast<T*>( ::operator new( n * sizeof(T) ) );
+    return static_cast<T*>( BlockPool<sizeof(T)>::shared().acquire() );
+  }
+
+  void deallocate( T *p, size_t n )
+  { if ( n != 1 )
+      ::operator delete( p );
+    else
+      BlockPool<sizeof(T)>::shared().release( p );
+  }
+
+  template<typename U> bool operator==( const PoolAllocator<U> & ) const { return true;  }
+  template<typename U> bool operator!=( const PoolAllocator<U> & ) const { return false; }
+};
+
+
+#endif // _PV_BLOCK_POOL_H
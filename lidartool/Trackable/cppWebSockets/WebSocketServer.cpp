@@ -79,9 +79,14 @@ static int callback_main(   struct lws *wsi,
 	    
 	    bool success = true;
 
+	    if ( self->connections.count(fd) && self->connections[fd]->overflowed )
+            { result = -1;
+	      break;
+	    }
+
 	    if ( self->connections.count(fd) && !self->connections[fd]->writeBuffer.empty() )
             {
-	      std::vector<uint8_t> &message = self->connections[fd]->writeBuffer.front();
+	      const std::string &message = *self->connections[fd]->writeBuffer.front();
 	      int msgLen = message.size();
 	      const int packSize = self->packSize;
 	
@@ -176,6 +181,9 @@ static struct lws_protocols protocols[] = {
 WebSocketServer::WebSocketServer( int port, const string certPath, const string& keyPath, bool binary )
 {
     this->_binary   = binary;
+    this->maxPending   = 0;
+    this->maxBacklog   = 0;
+    this->numConflated = 0;
     this->_port     = port;
     this->_certPath = certPath;
     this->_keyPath  = keyPath;
@@ -237,6 +245,8 @@ void WebSocketServer::onConnectWrapper( int socketID, const char *remoteIP )
     Connection* c = new Connection;
     c->createTime = time( 0 );
     c->charsSent  = 0;
+    c->conflated  = 0;
+    c->overflowed = false;
     c->keyValueMap["remoteIP"] = remoteIP;
     
     this->connections[ socketID ] = c;
@@ -256,16 +266,75 @@ void WebSocketServer::onErrorWrapper( int socketID, const string& message )
     this->_removeConnection( socketID );
 }
 
+WebSocketServer::Frame WebSocketServer::newFrame( const char *data, int length )
+{
+  return std::make_shared<const std::string>( data, length );
+}
+
+WebSocketServer::Frame WebSocketServer::newFrame( std::string &&data )
+{
+  return std::make_shared<const std::string>( std::move( data ) );
+}
+
 void WebSocketServer::send( int socketID, const char *data, int length )
+{
+  this->send( socketID, newFrame( data, length ) );
+}
+
+void WebSocketServer::send( int socketID, const Frame &frame )
 {
     // Push this onto the buffer. It will be written out when the socket is writable.
-  this->connections[socketID]->writeBuffer.push_back( std::vector<uint8_t>(data, &data[length]) );
+  Connection *c = this->connections[socketID];
+  list<Frame> &writeBuffer( c->writeBuffer );
+
+  if ( c->overflowed )
+    return;
+
+    // Messages that depend on their predecessors, like incremental events, can not
+    // be skipped. A client that falls too far behind is closed instead.
+  if ( !this->canConflate() )
+  {
+    if ( this->maxBacklog > 0 && (int)writeBuffer.size() >= this->maxBacklog )
+    { c->overflowed = true;
+      writeBuffer.clear();
+      c->charsSent  = 0;
+      return;
+    }
+  }
+    // A client that does not keep up gets the latest message instead of the backlog.
+    // The front message may already be partially written and has to stay.
+  else if ( this->maxPending > 0 && (int)writeBuffer.size() >= this->maxPending )
+  { 
+    auto begin = writeBuffer.begin();
+    if ( c->charsSent > 0 )
+      ++begin;
+
+    int num = std::distance( begin, writeBuffer.end() );
+    writeBuffer.erase( begin, writeBuffer.end() );
+
+    c->conflated       += num;
+    this->numConflated += num;
+
+    if ( num > 0 )
+      this->onConflate( socketID );
+  }
+
+  writeBuffer.push_back( frame );
 }
 
 void WebSocketServer::broadcast( const char *data, int length )
 {
+  if ( this->connections.empty() )
+    _deleteRemovedConnections();
+  else
+    this->broadcast( newFrame( data, length ) );
+}
+
+void WebSocketServer::broadcast( const Frame &frame )
+{
+    // The frame is serialized once and shared by all connections
   for( map<int,Connection*>::const_iterator it = this->connections.begin( ); it != this->connections.end(); ++it )
-    this->send( it->first, data, length );
+    this->send( it->first, frame );
 
   _deleteRemovedConnections();
 }
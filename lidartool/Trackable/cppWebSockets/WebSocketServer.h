@@ -24,6 +24,8 @@
 #include <iostream>
 #include <sstream>
 #include <mutex>
+#include <memory>
+#include <vector>
 #include "libwebsockets.h"
 
 using namespace std;
@@ -35,14 +37,19 @@ using namespace std;
 class WebSocketServer
 {
 public:
+    // A serialized message, shared by all connections it is queued on
+    typedef std::shared_ptr<const std::string> Frame;
+
     // Represents a client connection
     struct Connection
     {
         std::vector<uint8_t>       readBuffer; 
-        list<std::vector<uint8_t>> writeBuffer;     // Ordered list of pending messages to flush out when socket is writable
+        list<Frame>		   writeBuffer;     // Ordered list of pending messages to flush out when socket is writable
         map<string,string> 	   keyValueMap;
         time_t             	   createTime;
         int			   charsSent;
+        uint64_t		   conflated;       // pending messages replaced by a newer one
+        bool			   overflowed;      // backlog exceeded maxBacklog, closed on the next write
     };
 
     // Manages connections. Unfortunately this is public because static callback for
@@ -52,6 +59,9 @@ public:
 
     bool		 _binary;
     std::mutex 	 	  mutex;
+    int			  maxPending;       // pending messages per connection before conflating, 0 for unlimited
+    int			  maxBacklog;       // pending messages before a connection that can not conflate is closed, 0 for unlimited
+    uint64_t		  numConflated;
     
 
     static inline const int packSize = 4096;
@@ -63,7 +73,12 @@ public:
 
     void 	wait	 ( uint64_t timeout = 50     );
     void 	send	 ( int 	    socketID, const char *data, int length 	);
+    void 	send	 ( int 	    socketID, const Frame &frame 		);
     void 	broadcast( const char *data, int length   		);
+    void 	broadcast( const Frame &frame 				);
+
+    static Frame newFrame( const char *data, int length );
+    static Frame newFrame( std::string &&data );	// takes over data without copying
 
     // Key => value storage for each connection
     string getValue( int socketID, const string& name );
@@ -76,6 +91,11 @@ public:
     virtual void onDisconnect( int socketID                        ) = 0;
     virtual void onError     ( int socketID, const string& message ) = 0;
 
+    // Whether the latest message supersedes the pending ones, so a slow client may skip them
+    virtual bool canConflate ( ) { return true; }
+    // Called after pending messages of a slow client were dropped
+    virtual void onConflate  ( int socketID ) {}
+
 
     // Wrappers, so we can take care of some maintenance
     void onConnectWrapper(    int socketID, const char *remoteIP );
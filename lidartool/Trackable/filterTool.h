@@ -64,6 +64,7 @@ public:
   std::map<std::string, FilterFlag>  FlagMap;
   std::map<std::string, std::string> PersistentMap; // rapidjson needs persistent c pointers 
   uint64_t 					 filter;
+  int						 version;	// changes whenever the key mapping changes
 
   std::string					 object_id;
   bool						 initialized;
@@ -72,7 +73,8 @@ public:
     : KeyMap(),
       FlagMap(),
       PersistentMap(),
-      filter( 0 )
+      filter( 0 ),
+      version( 0 )
   { 
     initialized = false;
   }
@@ -82,6 +84,7 @@ public:
     KeyMap.emplace (name, name);
     FlagMap.emplace(name, (FilterFlag)flag);
     initialized = true;
+    version    += 1;
   }
 
   virtual std::string km( std::string key, std::string label="", uint64_t frame_count=0, uint64_t timestamp=0, int id=0 )
@@ -134,6 +137,7 @@ public:
   void parseFilter( const char *filter )
   {
     this->filter = 0;
+    version     += 1;
     
     std::stringstream s_stream(filter); //create string stream from the string
     while(s_stream.good()) {
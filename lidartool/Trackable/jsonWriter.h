@@ -0,0 +1,122 @@
+// Copyright (c) 2023 ZKM | Hertz-Lab (http://www.zkm.de)
+// Bernd Lintermann <bernd.lintermann@zkm.de>
+//
+// BSD Simplified License.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE" in this distribution.
+//
+
+#ifndef _PV_JSON_WRITER_H
+#define _PV_JSON_WRITER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <charconv>
+
+/***************************************************************************
+*** 
+*** JsonWriter
+***
+****************************************************************************/
+
+// appends json to a buffer that keeps its capacity from message to message.
+// Separators are inserted on demand, so a caller may remember size(),
+// write a member and truncate() back to drop it if it turned out empty
+
+class JsonWriter
+{
+public:
+  std::string	buffer;
+
+  void   clear()		{ buffer.clear(); }
+  bool   empty() const		{ return buffer.empty(); }
+  size_t size()  const		{ return buffer.size(); }
+  void   truncate( size_t size ) { buffer.resize( size ); }
+
+  void separator()
+  {
+    if ( buffer.empty() )
+      return;
+
+    char c = buffer.back();
+    if ( c != '{' && c != '[' && c != ':' )
+      buffer += ',';
+  }
+
+  void key( const char *key )
+  {
+    separator();
+    buffer += '"';
+    buffer += key;
+    buffer += "\":";
+  }
+
+  void beginObject()	{ separator(); buffer += '{'; }
+  void endObject()	{ buffer += '}'; }
+  void beginArray()	{ separator(); buffer += '['; }
+  void endArray()	{ buffer += ']'; }
+
+  void raw( const char *string, size_t length )
+  { buffer.append( string, length );
+  }
+
+  void raw( const std::string &string )
+  { buffer += string;
+  }
+
+  void valueInt( int64_t value )
+  {
+    char s[24];
+    char *end = std::to_chars( s, s+sizeof(s), value ).ptr;
+    buffer.append( s, end-s );
+  }
+
+  void valueUInt( uint64_t value )
+  {
+    char s[24];
+    char *end = std::to_chars( s, s+sizeof(s), value ).ptr;
+    buffer.append( s, end-s );
+  }
+
+  void valueFloat( float value )	// floating point to_chars needs GCC 11, snprintf is fine for all targets
+  {
+    char s[64];
+    int len = snprintf( s, sizeof(s), "%.3f", value );
+    if ( len > 0 && len < (int)sizeof(s) )
+      buffer.append( s, len );
+    else
+      buffer += "0.000";
+  }
+
+  void valueString( const char *string )
+  {
+    buffer += '"';
+
+    for ( const char *c = string; *c != '\0'; ++c )
+    {
+      if ( *c == '"' || *c == '\\' )
+      { buffer += '\\';
+	buffer += *c;
+      }
+      else if ( (unsigned char)*c < 0x20 )
+      { char s[8];
+	snprintf( s, sizeof(s), "\\u%04x", (unsigned char)*c );
+	buffer += s;
+      }
+      else
+	buffer += *c;
+    }
+
+    buffer += '"';
+  }
+
+  void setInt   ( const char *name, int64_t value )		{ key( name ); valueInt   ( value ); }
+  void setFloat ( const char *name, float value )		{ key( name ); valueFloat ( value ); }
+  void setString( const char *name, const char *value )		{ key( name ); valueString( value ); }
+  void setString( const char *name, const std::string &value )	{ key( name ); valueString( value.c_str() ); }
+};
+
+
+#endif // _PV_JSON_WRITER_H
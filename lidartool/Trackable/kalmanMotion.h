@@ -0,0 +1,102 @@
+// Copyright (c) 2023 ZKM | Hertz-Lab (http://www.zkm.de)
+// Bernd Lintermann <bernd.lintermann@zkm.de>
+//
+// BSD Simplified License.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE" in this distribution.
+//
+
+#ifndef _PV_KALMAN_MOTION_H
+#define _PV_KALMAN_MOTION_H
+
+/***************************************************************************
+***
+*** KalmanMotion
+***
+****************************************************************************/
+
+// constant velocity Kalman filter on the ground plane. Noise is isotropic,
+// so x and y evolve with the same 2x2 covariance [pp pv; pv vv] which is
+// stored only once. Process noise is white acceleration with variance q,
+// measurement noise has variance r per axis.
+
+class KalmanMotion
+{
+public:
+  bool		valid;
+  float		x[2];
+  float		v[2];
+  float		pp, pv, vv;
+
+  KalmanMotion()
+  : valid( false )
+  {}
+
+  void reset()
+  { valid = false;
+  }
+
+  void init( float px, float py, float r, float velocityVar=1.0f )
+  {
+    x[0]  = px;
+    x[1]  = py;
+    v[0]  = 0.0f;
+    v[1]  = 0.0f;
+    pp    = r;
+    pv    = 0.0f;
+    vv    = velocityVar;
+    valid = true;
+  }
+
+  void predict( float dt, float q )
+  {
+    if ( dt <= 0.0f )
+      return;
+
+    const float dt2 = dt  * dt;
+    const float dt3 = dt2 * dt;
+    const float dt4 = dt3 * dt;
+
+    x[0] += v[0] * dt;
+    x[1] += v[1] * dt;
+
+    pp += 2.0f * dt * pv + dt2 * vv + 0.25f * q * dt4;
+    pv += dt * vv + 0.5f * q * dt3;
+    vv += q * dt2;
+  }
+
+	/* per axis variance of the innovation */
+  float innovationVar( float r ) const
+  { return pp + r;
+  }
+
+	/* squared Mahalanobis distance of a measurement, chi-square with 2 dof */
+  float mahalanobis2( float mx, float my, float r ) const
+  {
+    const float dx = mx - x[0];
+    const float dy = my - x[1];
+
+    return (dx*dx + dy*dy) / innovationVar( r );
+  }
+
+  void update( float mx, float my, float r )
+  {
+    const float s  = innovationVar( r );
+    const float kp = pp / s;
+    const float kv = pv / s;
+    const float dx = mx - x[0];
+    const float dy = my - x[1];
+
+    x[0] += kp * dx;
+    x[1] += kp * dy;
+    v[0] += kv * dx;
+    v[1] += kv * dy;
+
+    vv -= kv * pv;
+    pv *= 1.0f - kp;
+    pp *= 1.0f - kp;
+  }
+};
+
+
+#endif // _PV_KALMAN_MOTION_H
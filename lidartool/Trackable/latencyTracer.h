@@ -0,0 +1,217 @@
+// Copyright (c) 2023 ZKM | Hertz-Lab (http://www.zkm.de)
+// Bernd Lintermann <bernd.lintermann@zkm.de>
+//
+// BSD Simplified License.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE" in this distribution.
+//
+
+#ifndef _PV_LATENCY_TRACER_H
+#define _PV_LATENCY_TRACER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+/***************************************************************************
+*** 
+*** LatencyHistogram
+***
+****************************************************************************/
+
+// log scaled histogram of durations in usec with 8 buckets per octave,
+// lock free so it can be filled from the device threads and the tracker
+
+class LatencyHistogram
+{
+public:
+  static const int subBits    = 3;
+  static const int numSub     = 1 << subBits;
+  static const int numOctaves = 28;
+  static const int numBuckets = (numOctaves+1) * numSub;
+
+  std::atomic<uint32_t>	buckets[numBuckets];
+  std::atomic<uint64_t>	count;
+  std::atomic<uint64_t>	sum;
+  std::atomic<uint64_t>	max;
+
+  LatencyHistogram()
+  { reset();
+  }
+
+  static int bucket( uint64_t usec )
+  {
+    if ( usec < numSub )
+      return (int)usec;
+
+    int msb    = 63 - __builtin_clzll( usec );
+    int octave = msb - subBits + 1;
+
+    if ( octave > numOctaves )
+      return numBuckets-1;
+
+    return octave * numSub + (int)((usec >> (msb-subBits)) & (numSub-1));
+  }
+
+  static uint64_t bucketValue( int bucket )
+  {
+    if ( bucket < numSub )
+      return bucket;
+
+    int octave = bucket / numSub;
+    int shift  = octave - 1;
+
+    return ((uint64_t)(numSub | (bucket & (numSub-1))) << shift) + ((1ULL << shift) >> 1);
+  }
+
+  void add( uint64_t usec )
+  {
+    buckets[bucket(usec)].fetch_add( 1, std::memory_order_relaxed );
+    count.fetch_add( 1, std::memory_order_relaxed );
+    sum.fetch_add( usec, std::memory_order_relaxed );
+
+    uint64_t prev = max.load( std::memory_order_relaxed );
+    while ( usec > prev && !max.compare_exchange_weak( prev, usec, std::memory_order_relaxed ) )
+      ;
+  }
+
+  uint64_t percentile( double p ) const
+  {
+    uint64_t total = 0;
+    for ( int i = 0; i < numBuckets; ++i )
+      total += buckets[i].load( std::memory_order_relaxed );
+
+    if ( total == 0 )
+      return 0;
+
+    uint64_t rank = (uint64_t)(p * total + 0.5);
+    if ( rank < 1 )
+      rank = 1;
+
+    uint64_t accum = 0;
+    for ( int i = 0; i < numBuckets; ++i )
+    { accum += buckets[i].load( std::memory_order_relaxed );
+      if ( accum >= rank )
+	return bucketValue( i );
+    }
+
+    return bucketValue( numBuckets-1 );
+  }
+
+  uint64_t mean() const
+  { uint64_t n = count.load( std::memory_order_relaxed );
+    return n == 0 ? 0 : sum.load( std::memory_order_relaxed ) / n;
+  }
+
+  void reset()
+  {
+    for ( int i = 0; i < numBuckets; ++i )
+      buckets[i].store( 0, std::memory_order_relaxed );
+    count.store( 0, std::memory_order_relaxed );
+    sum.store( 0, std::memory_order_relaxed );
+    max.store( 0, std::memory_order_relaxed );
+  }
+};
+
+/***************************************************************************
+*** 
+*** LatencyTracer
+***
+****************************************************************************/
+
+// per stage durations on the path from sensor read to observer emit,
+// Total is the age of the oldest sensor frame when its objects got emitted
+
+class LatencyTracer
+{
+public:
+  enum Stage
+  {
+    Receive,	// scan data arrived until the device thread handed the scan to processing
+    Scan,	// raw samples converted into the sample buffer
+    Detect,	// detectObjects()
+    Merge,	// mergeObjects()/mergeStages() and unite() without observers
+    Observe,	// observer observe() for one frame
+    Write,	// socket write of one observer
+    Total,	// driver receive to observer emit
+    NumStages
+  };
+
+  LatencyHistogram	stages[NumStages];
+
+  static const char *stageName( int stage )
+  {
+    static const char *names[NumStages] = { "receive", "scan", "detect", "merge", "observe", "write", "total" };
+    return stage >= 0 && stage < NumStages ? names[stage] : "";
+  }
+
+  static uint64_t usec()
+  { return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  static LatencyTracer &global()
+  { static LatencyTracer tracer;
+    return tracer;
+  }
+
+  static void add( Stage stage, uint64_t duration )
+  { global().stages[stage].add( duration );
+  }
+
+  static void addSince( Stage stage, uint64_t start )
+  { uint64_t now = usec();
+    global().stages[stage].add( now > start ? now - start : 0 );
+  }
+
+  void reset()
+  { for ( int i = 0; i < NumStages; ++i )
+      stages[i].reset();
+  }
+
+  std::string json() const
+  {
+    std::string json( "{" );
+
+    for ( int i = 0; i < NumStages; ++i )
+    {
+      const LatencyHistogram &hist( stages[i] );
+
+      if ( i > 0 )
+	json += ",";
+
+      json += " \"";
+      json += stageName( i );
+      json += "\": { \"count\": " + std::to_string( hist.count.load(std::memory_order_relaxed) );
+      json += ", \"mean\": "      + std::to_string( hist.mean() );
+      json += ", \"p50\": "       + std::to_string( hist.percentile( 0.50 ) );
+      json += ", \"p95\": "       + std::to_string( hist.percentile( 0.95 ) );
+      json += ", \"p99\": "       + std::to_string( hist.percentile( 0.99 ) );
+      json += ", \"max\": "       + std::to_string( hist.max.load(std::memory_order_relaxed) );
+      json += " }";
+    }
+
+    json += " }";
+
+    return json;
+  }
+
+  class Scope
+  {
+    Stage    stage;
+    uint64_t start;
+
+  public:
+    Scope( Stage stage )
+    : stage( stage ),
+      start( usec() )
+    {}
+
+    ~Scope()
+    { addSince( stage, start );
+    }
+  };
+};
+
+
+#endif // _PV_LATENCY_TRACER_H
@@ -0,0 +1,212 @@
+// Copyright (c) 2023 ZKM | Hertz-Lab (http://www.zkm.de)
+// Bernd Lintermann <bernd.lintermann@zkm.de>
+//
+// BSD Simplified License.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE" in this distribution.
+//
+
+#ifndef _PV_MESSAGE_QUEUE_H
+#define _PV_MESSAGE_QUEUE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+/***************************************************************************
+*** 
+*** MessageQueue
+***
+****************************************************************************/
+
+// bounded ring of message slots between any number of producers and one
+// writer thread. Messages are swapped in and out of the slots, so the
+// strings keep their capacity and nothing is copied or allocated once the
+// ring is warm. The policy decides what happens when the ring is full
+
+class MessageQueue
+{
+public:
+  enum Policy
+  {
+    DropOldest,
+    DropNewest,
+    Block
+  };
+
+  MessageQueue( int capacity=256, Policy policy=DropOldest )
+  : slots   ( capacity < 1 ? 1 : capacity ),
+    head    ( 0 ),
+    count   ( 0 ),
+    inFlight( 0 ),
+    dropped ( 0 ),
+    policy  ( policy ),
+    woken   ( false )
+  {}
+
+  void setCapacity( int capacity )
+  {
+    std::lock_guard<std::mutex> guard( mutex );
+
+    if ( capacity < 1 )
+      capacity = 1;
+
+    std::vector<std::string> ring( capacity );
+    while ( count > capacity )
+      drop();
+    for ( int i = 0; i < count; ++i )
+      ring[i].swap( slots[(head+i) % slots.size()] );
+
+    slots.swap( ring );
+    head = 0;
+  }
+
+  void setPolicy( Policy policy )
+  { std::lock_guard<std::mutex> guard( mutex );
+    this->policy = policy;
+  }
+
+  static Policy policyByName( const std::string &name, Policy policy=DropOldest )
+  {
+    if ( name == "dropOldest" )
+      return DropOldest;
+    if ( name == "dropNewest" )
+      return DropNewest;
+    if ( name == "block" )
+      return Block;
+    return policy;
+  }
+
+	/* swaps message into the queue, message gets an empty recycled string */
+
+  bool push( std::string &message )
+  {
+    std::unique_lock<std::mutex> lock( mutex );
+
+    if ( count == (int)slots.size() )
+    {
+      if ( policy == Block )
+	notFull.wait( lock, [this] { return count < (int)slots.size() || woken; } );
+      else if ( policy == DropNewest )
+      { dropped += 1;
+	message.clear();
+	return false;
+      }
+
+      if ( count == (int)slots.size() )
+	drop();
+    }
+
+    std::string &slot( slots[(head+count) % slots.size()] );
+    slot.swap( message );
+    message.clear();
+    count += 1;
+
+    lock.unlock();
+    notEmpty.notify_one();
+
+    return true;
+  }
+
+	/* waits up to timeout msec for messages, returns false if still empty */
+
+  bool wait( int timeout )
+  {
+    std::unique_lock<std::mutex> lock( mutex );
+
+    notEmpty.wait_for( lock, std::chrono::milliseconds( timeout ), [this] { return count > 0 || woken; } );
+    woken = false;
+
+    return count > 0;
+  }
+
+	/* swaps all queued messages into messages, call done() once they are written */
+
+  int pop( std::vector<std::string> &messages )
+  {
+    std::unique_lock<std::mutex> lock( mutex );
+
+    int num = count;
+    messages.resize( num );
+
+    for ( int i = 0; i < num; ++i )
+    { messages[i].swap( slots[head] );
+      slots[head].clear();
+      head = (head+1) % slots.size();
+    }
+
+    count     = 0;
+    inFlight += num;
+
+    lock.unlock();
+    if ( num > 0 )
+      notFull.notify_all();
+
+    return num;
+  }
+
+  void done( int num )
+  {
+    { std::lock_guard<std::mutex> guard( mutex );
+      inFlight -= num;
+    }
+    drained.notify_all();
+  }
+
+	/* waits up to timeout msec until everything queued is written */
+
+  bool waitDrained( int timeout )
+  {
+    std::unique_lock<std::mutex> lock( mutex );
+
+    return drained.wait_for( lock, std::chrono::milliseconds( timeout ), [this] { return count == 0 && inFlight == 0; } );
+  }
+
+	/* releases a waiting writer or blocked producers, e.g. on exit */
+
+  void wake()
+  {
+    { std::lock_guard<std::mutex> guard( mutex );
+      woken = true;
+    }
+    notEmpty.notify_all();
+    notFull.notify_all();
+  }
+
+  int depth()
+  { std::lock_guard<std::mutex> guard( mutex );
+    return count;
+  }
+
+  uint64_t numDropped()
+  { std::lock_guard<std::mutex> guard( mutex );
+    return dropped;
+  }
+
+protected:
+  std::vector<std::string>	slots;
+  int				head;
+  int				count;
+  int				inFlight;
+  uint64_t			dropped;
+  Policy			policy;
+  bool				woken;
+  std::mutex			mutex;
+  std::condition_variable	notEmpty;
+  std::condition_variable	notFull;
+  std::condition_variable	drained;
+
+  void drop()
+  {
+    slots[head].clear();
+    head     = (head+1) % slots.size();
+    count   -= 1;
+    dropped += 1;
+  }
+};
+
+
+#endif // _PV_MESSAGE_QUEUE_H
@@ -0,0 +1,114 @@
+// Copyright (c) 2023 ZKM | Hertz-Lab (http://www.zkm.de)
+// Bernd Lintermann <bernd.lintermann@zkm.de>
+//
+// BSD Simplified License.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE" in this distribution.
+//
+
+#ifndef _PV_SPATIAL_GRID_H
+#define _PV_SPATIAL_GRID_H
+
+#include <vector>
+#include <math.h>
+
+/***************************************************************************
+*** 
+*** SpatialGrid
+***
+****************************************************************************/
+
+// uniform 2D hash grid for neighbour queries, filled with add() and
+// build() once per frame. query() calls back every entry in the cells
+// overlapping the query circle, callers still check the exact distance.
+
+template<typename T> class SpatialGrid
+{
+public:
+  class Entry
+  {
+  public:
+    int		cx, cy;
+    T		value;
+  };
+
+  SpatialGrid()
+  : cellSize ( 1.0f ),
+    mask     ( 0 )
+  {}
+
+  void clear( float cellSize )
+  {
+    this->cellSize = (cellSize > 0.0f ? cellSize : 1.0f);
+    entries.resize( 0 );
+  }
+
+  void add( float x, float y, const T &value )
+  { entries.push_back( Entry({cell(x), cell(y), value}) );
+  }
+
+  int size() const
+  { return entries.size(); }
+
+  void build()
+  {
+    int numBuckets = 16;
+    while ( numBuckets < 2 * (int)entries.size() )
+      numBuckets *= 2;
+    mask = numBuckets - 1;
+
+    bucketStart.assign( numBuckets+1, 0 );
+    for ( int i = 0; i < entries.size(); ++i )
+      bucketStart[bucket(entries[i].cx,entries[i].cy)+1] += 1;
+    for ( int b = 0; b < numBuckets; ++b )
+      bucketStart[b+1] += bucketStart[b];
+
+    sorted.resize( entries.size() );
+    fill.assign( bucketStart.begin(), bucketStart.end()-1 );
+    for ( int i = 0; i < entries.size(); ++i )
+      sorted[fill[bucket(entries[i].cx,entries[i].cy)]++] = entries[i];
+  }
+
+  template<typename F> void query( float x, float y, float radius, F func ) const
+  {
+    int range = (int) ceilf( radius / cellSize );
+
+    if ( (2*range+1) * (2*range+1) >= (int)sorted.size() )
+    { for ( int i = 0; i < sorted.size(); ++i )
+	func( sorted[i].value );
+      return;
+    }
+
+    int cx = cell( x );
+    int cy = cell( y );
+
+    for ( int ix = cx-range; ix <= cx+range; ++ix )
+    { for ( int iy = cy-range; iy <= cy+range; ++iy )
+      {
+	int b = bucket( ix, iy );
+	for ( int i = bucketStart[b]; i < bucketStart[b+1]; ++i )
+	  if ( sorted[i].cx == ix && sorted[i].cy == iy )
+	    func( sorted[i].value );
+      }
+    }
+  }
+
+protected:
+  float			cellSize;
+  int			mask;
+  std::vector<Entry>	entries;
+  std::vector<Entry>	sorted;
+  std::vector<int>	bucketStart;
+  std::vector<int>	fill;
+
+  int cell( float v ) const
+  { return (int) floorf( v / cellSize );
+  }
+
+  int bucket( int cx, int cy ) const
+  { return (int)(((unsigned)cx * 73856093u) ^ ((unsigned)cy * 19349663u)) & mask;
+  }
+};
+
+
+#endif // _PV_SPATIAL_GRID_H
@@ -0,0 +1,220 @@
+// Copyright (c) 2023 ZKM | Hertz-Lab (http://www.zkm.de)
+// Bernd Lintermann <bernd.lintermann@zkm.de>
+//
+// BSD Simplified License.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE" in this distribution.
+//
+
+#ifndef _PV_TRACK_ASSIGNMENT_H
+#define _PV_TRACK_ASSIGNMENT_H
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+/***************************************************************************
+*** 
+*** TrackAssignment
+***
+****************************************************************************/
+
+// assigns rows (e.g. new detections) to columns (e.g. known objects) given a
+// sparse list of gated candidate pairs. solveOptimal() minimizes the sum of
+// the assigned costs plus gate for each unassigned row with a sparse
+// Jonker-Volgenant style shortest augmenting path, one Dijkstra run per row.
+// solveGreedy() is the former sort and take scheme.
+
+class TrackAssignment
+{
+public:
+  class Candidate
+  {
+  public:
+    float	cost;
+    int		row;
+    int		col;
+
+    bool operator<( const Candidate &other ) const
+    { return cost < other.cost; }
+  };
+
+  std::vector<Candidate> candidates;
+  std::vector<int>	 rowMatch;	// assigned col per row or -1
+  std::vector<int>	 colMatch;	// assigned row per col or -1
+
+  void clear( int numRows, int numCols )
+  {
+    candidates.resize( 0 );
+    rowMatch.assign( numRows, -1 );
+    colMatch.assign( numCols, -1 );
+  }
+
+  void add( int row, int col, float cost )
+  { candidates.push_back( Candidate({cost, row, col}) );
+  }
+
+  void sort()
+  { std::sort( candidates.begin(), candidates.end() );
+  }
+
+  void solve( float gate, bool optimal=true )
+  {
+    if ( optimal )
+      solveOptimal( gate );
+    else
+      solveGreedy();
+  }
+
+  void solveGreedy()
+  {
+    sort();
+
+    for ( int i = 0; i < candidates.size(); ++i )
+    {
+      const Candidate &c( candidates[i] );
+
+      if ( rowMatch[c.row] < 0 && colMatch[c.col] < 0 )
+      { rowMatch[c.row] = c.col;
+	colMatch[c.col] = c.row;
+      }
+    }
+  }
+
+  void solveOptimal( float gate )
+  {
+    const int    numRows  = rowMatch.size();
+    const int    numCols  = colMatch.size();
+    const int    numNodes = numCols + numRows;	// a private dummy column per row costs gate
+    const double inf      = std::numeric_limits<double>::infinity();
+
+    if ( candidates.size() == 0 )
+      return;
+
+	/* candidates by row */
+    rowStart.assign( numRows+1, 0 );
+    for ( int i = 0; i < candidates.size(); ++i )
+      rowStart[candidates[i].row+1] += 1;
+    for ( int r = 0; r < numRows; ++r )
+      rowStart[r+1] += rowStart[r];
+
+    edges.resize( candidates.size() );
+    fill.assign( rowStart.begin(), rowStart.end()-1 );
+    for ( int i = 0; i < candidates.size(); ++i )
+      edges[fill[candidates[i].row]++] = candidates[i];
+
+    u.assign( numRows, 0.0 );
+    v.assign( numNodes, 0.0 );
+    dist.assign( numNodes, inf );
+    path.assign( numNodes, -1 );
+    done.assign( numNodes, 0 );
+    row4col.assign( numNodes, -1 );
+    col4row.assign( numRows, -1 );
+
+    for ( int cur = 0; cur < numRows; ++cur )
+    {
+      if ( rowStart[cur] == rowStart[cur+1] )
+	continue;
+
+      touched.resize( 0 );
+      scanned.resize( 0 );
+      heap.resize( 0 );
+
+      double minVal = 0.0;
+      int    sink   = -1;
+      int    row    = cur;
+
+      while ( true )
+      {
+	scanned.push_back( row );
+
+	for ( int e = rowStart[row]; e <= rowStart[row+1]; ++e )
+	{
+	  int   col  = (e < rowStart[row+1] ? edges[e].col  : numCols+row);
+	  float cost = (e < rowStart[row+1] ? edges[e].cost : gate);
+
+	  if ( done[col] )
+	    continue;
+
+	  double r = minVal + cost - u[row] - v[col];
+	  if ( r < dist[col] )
+	  { if ( dist[col] == inf )
+	      touched.push_back( col );
+	    dist[col] = r;
+	    path[col] = row;
+	    heap.push_back( std::make_pair( r, col ) );
+	    std::push_heap( heap.begin(), heap.end(), std::greater<std::pair<double,int>>() );
+	  }
+	}
+
+	int col = -1;
+	while ( heap.size() > 0 && col < 0 )
+	{ std::pop_heap( heap.begin(), heap.end(), std::greater<std::pair<double,int>>() );
+	  std::pair<double,int> top( heap.back() );
+	  heap.pop_back();
+	  if ( !done[top.second] && top.first <= dist[top.second] )
+	    col = top.second;
+	}
+
+	if ( col < 0 )
+	  break;
+
+	done[col] = 1;
+	minVal    = dist[col];
+
+	if ( row4col[col] < 0 )
+	{ sink = col;
+	  break;
+	}
+
+	row = row4col[col];
+      }
+
+      if ( sink >= 0 )
+      {
+	    /* update the dual variables */
+	u[cur] += minVal;
+	for ( int i = 1; i < scanned.size(); ++i )
+	  u[scanned[i]] += minVal - dist[col4row[scanned[i]]];
+	for ( int i = 0; i < touched.size(); ++i )
+	  if ( done[touched[i]] )
+	    v[touched[i]] -= minVal - dist[touched[i]];
+
+	    /* augment along the shortest path */
+	for ( int col = sink; true; )
+	{ int row = path[col];
+	  row4col[col] = row;
+	  std::swap( col4row[row], col );
+	  if ( row == cur )
+	    break;
+	}
+      }
+
+      for ( int i = 0; i < touched.size(); ++i )
+      { dist[touched[i]] = inf;
+	done[touched[i]] = 0;
+      }
+    }
+
+    for ( int r = 0; r < numRows; ++r )
+    { int col = col4row[r];
+      if ( col >= 0 && col < numCols )
+      { rowMatch[r]   = col;
+	colMatch[col] = r;
+      }
+    }
+  }
+
+protected:
+  std::vector<Candidate> edges;
+  std::vector<int>	 rowStart, fill;
+  std::vector<double>	 u, v, dist;
+  std::vector<int>	 path, row4col, col4row;
+  std::vector<int>	 touched, scanned;
+  std::vector<char>	 done;
+  std::vector<std::pair<double,int>> heap;
+};
+
+
+#endif // _PV_TRACK_ASSIGNMENT_H
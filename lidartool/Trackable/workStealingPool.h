@@ -0,0 +1,144 @@
+// Copyright (c) 2023 ZKM | Hertz-Lab (http://www.zkm.de)
+// Bernd Lintermann <bernd.lintermann@zkm.de>
+//
+// BSD Simplified License.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE" in this distribution.
+//
+
+#ifndef _PV_WORK_STEALING_POOL_H
+#define _PV_WORK_STEALING_POOL_H
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+/***************************************************************************
+***
+*** WorkStealingPool
+***
+****************************************************************************/
+
+// fixed number of worker threads, each with its own task deque. A worker
+// takes its newest task first and steals the oldest task of another worker
+// when its own deque runs empty. submit() places a task in the deque of the
+// given slot, so tasks of one producer stay on one core while it is idle.
+
+class WorkStealingPool
+{
+public:
+  typedef std::function<void()> Task;
+
+  WorkStealingPool( int numThreads )
+  : pending( 0 ),
+    nextSlot( 0 ),
+    exiting( false )
+  {
+    if ( numThreads < 1 )
+      numThreads = 1;
+
+    for ( int i = 0; i < numThreads; ++i )
+      workers.push_back( std::unique_ptr<Worker>( new Worker() ) );
+    for ( int i = 0; i < numThreads; ++i )
+      threads.push_back( std::thread( &WorkStealingPool::run, this, i ) );
+  }
+
+  ~WorkStealingPool()
+  {
+    { std::lock_guard<std::mutex> guard( mutex );
+      exiting = true;
+    }
+    cond.notify_all();
+
+    for ( int i = 0; i < threads.size(); ++i )
+      threads[i].join();
+  }
+
+  int numThreads() const
+  { return workers.size();
+  }
+
+  void submit( Task task, int slot=-1 )
+  {
+    if ( slot < 0 )
+      slot = nextSlot.fetch_add( 1 );
+
+    Worker &worker( *workers[slot % workers.size()] );
+
+    { std::lock_guard<std::mutex> guard( worker.mutex );
+      worker.tasks.push_back( std::move(task) );
+    }
+    { std::lock_guard<std::mutex> guard( mutex );
+      pending += 1;
+    }
+    cond.notify_one();
+  }
+
+protected:
+  class Worker
+  {
+  public:
+    std::mutex		mutex;
+    std::deque<Task>	tasks;
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::vector<std::thread>	threads;
+  std::mutex			mutex;
+  std::condition_variable	cond;
+  int				pending;
+  std::atomic<int>		nextSlot;
+  bool				exiting;
+
+  bool take( int index, Task &task )
+  {
+    { Worker &worker( *workers[index] );
+      std::lock_guard<std::mutex> guard( worker.mutex );
+      if ( worker.tasks.size() > 0 )
+      { task = std::move( worker.tasks.back() );
+	worker.tasks.pop_back();
+	return true;
+      }
+    }
+
+    for ( int i = 1; i < workers.size(); ++i )
+    { Worker &victim( *workers[(index+i) % workers.size()] );
+      std::lock_guard<std::mutex> guard( victim.mutex );
+      if ( victim.tasks.size() > 0 )
+      { task = std::move( victim.tasks.front() );
+	victim.tasks.pop_front();
+	return true;
+      }
+    }
+
+    return false;
+  }
+
+  void run( int index )
+  {
+    while ( true )
+    {
+      { std::unique_lock<std::mutex> lock( mutex );
+	cond.wait( lock, [this] { return pending > 0 || exiting; } );
+	if ( pending == 0 )
+	  return;
+	pending -= 1;
+      }
+
+	  /* a task was counted before it was notified, so one is queued */
+      Task task;
+      while ( !take( index, task ) )
+	std::this_thread::yield();
+
+      task();
+    }
+  }
+};
+
+
+#endif // _PV_WORK_STEALING_POOL_H
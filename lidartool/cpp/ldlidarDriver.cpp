@@ -348,9 +348,7 @@ LDLidarDriver::grabScanData( ScanData &data, int timeout )
 
   int size = laserScan.size();
 
-  ldlidar::Points2D   filteredScan;
-  filteredScan.resize( size );
-  
+  data.resize( size );
 
   ldlidar::PointData *lastScanData = &laserScan[size-1];
   ldlidar::PointData *scanData     = &laserScan[0];
@@ -358,40 +356,31 @@ LDLidarDriver::grabScanData( ScanData &data, int timeout )
 
   for ( int i = 0; i < size; ++i )
   {
-    filteredScan[i] = *scanData;
+    ScanPoint &sample( data[i] );
+   
+    sample.distance = scanData->distance / 1000.0;
+    sample.angle    = scanData->angle;
+    sample.quality  = scanData->intensity;
 
     nextScanData = &laserScan[(i+1)%size];
 
     if ( scanData->intensity > minNoiseIntensity )
     {
       if ( scanData->distance < minDistance )
-	filteredScan[i].intensity = 0;
+	sample.quality = 0;
       else if ( lastScanData->intensity <= minNoiseIntensity && nextScanData->intensity <= minNoiseIntensity )
-	filteredScan[i].intensity = 0;
+	sample.quality = 0;
       else if ( (lastScanData->intensity > minNoiseIntensity && abs(lastScanData->distance-scanData->distance) < maxNoiseDistance) ||
 		(nextScanData->intensity > minNoiseIntensity && abs(nextScanData->distance-scanData->distance) < maxNoiseDistance) )
 	;
       else
-	filteredScan[i].intensity = 0;
+	sample.quality = 0;
     }
     
     lastScanData = scanData;
     scanData     = nextScanData;
   }
 
-  data.resize( size );
-
-  for ( int i = size-1; i >= 0; --i )
-  {
-//    ldlidar::PointData &scanData( laserScan[i] );
-    ldlidar::PointData &scanData( filteredScan[i] );
-    ScanPoint &sample   ( data[i] );
-   
-    sample.distance = scanData.distance / 1000.0;
-    sample.angle    = scanData.angle;
-    sample.quality  = scanData.intensity;
-  }
-
   return true;
 }
 
@@ -16,6 +16,12 @@
 #include <atomic>
 #include <stdarg.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include "helper.h"
 #include "keyValueMap.h"
 #include "lidarKit.h"
@@ -43,6 +49,8 @@ static const int    ld06EnvMinQuality  = 12;
 
 static std::vector<LidarDevice*> g_DeviceList;
 
+static int   g_ComputeThreads		= 0;	// 0 processes scans in the device threads
+
 static int   g_Verbose			= false;
 static bool  g_Debug	 		= false;
 static bool  g_Shutdown			= false;
@@ -56,6 +64,7 @@ std::string LidarDevice::configDir( "" );
 std::string LidarDevice::configDirAlt( "" );
 std::string LidarDevice::defaultDeviceType( "" );
 std::string LidarDevices::message;
+LidarFrameSignal LidarDevice::frameSignal;
 
 float LidarObject::maxMarkerDistance = 2.5;
 
@@ -1136,125 +1145,207 @@ imageEnd( const char *name )
 
 /***************************************************************************
 *** 
-*** LidarObject
+*** LidarObjectFeatures
 ***
 ****************************************************************************/
 
 float
-LidarObject::lineScatter( LidarSampleBuffer &sampleBuffer ) const
+LidarObjectFeatures::curvature( const Vector2D &first, const Vector2D &mean, const Vector2D &last )
 {
-  LidarSample &lowerSample( sampleBuffer[lowerIndex%sampleBuffer.size()] );
+  Vector2D v0( mean - first );
+  Vector2D v1( last - mean );
+
+  v0.normalize();
+  v1.normalize();
 
-  Vector3D vec( sampleBuffer[higherIndex%sampleBuffer.size()].coord - lowerSample.coord );
-  float lineLength = vec.length();
+  Vector3D V0( v0 );
+  Vector3D V1( v1 );
 
-  vec /= lineLength;
+  Vector3D prod = V0.product( V1 );
+
+  double  angle = prod.length();
   
-  float sum = 0;
-  int count = 0;
+  if ( prod.z < 0 )
+    angle *= -1.0;
+
+  double curv = asin( angle ) / M_PI_2;
   
-  for ( int angIndex = higherIndex-1; angIndex > lowerIndex; --angIndex )
+  const double maxCurvature = 0.75;
+  curv /= maxCurvature;
+
+  if ( curv > 1.0 )
+    curv = 1.0;
+  else if ( curv < 0.0 )
+    curv = 0.0;
+
+  return curv;
+}
+
+void
+LidarObjectFeatures::extract( LidarObjects &objects, LidarSampleBuffer &sampleBuffer )
+{
+  const int size = sampleBuffer.size();
+
+  x.resize( 0 );
+  y.resize( 0 );
+  begin.resize( 0 );
+
+	/* gather the valid coordinates of all objects */
+
+  for ( int oi = 0; oi < objects.size(); ++oi )
   {
-    LidarSample &sample( sampleBuffer[angIndex%sampleBuffer.size()] );
+    const LidarObject &object( objects[oi] );
 
-    if ( sample.isValid() )
+    begin.push_back( x.size() );
+
+    int index = object.lowerIndex % size;
+
+    for ( int count = object.higherIndex - object.lowerIndex; count >= 0; --count )
     {
-      Vector3D p( sample.coord - lowerSample.coord );
-      float distance = p.product( vec ).length();
-    
-      sum   += distance;
-      count += 1;
+      const LidarSample &sample( sampleBuffer[index] );
+
+      if ( sample.isValid() )
+      { x.push_back( sample.coord.x );
+	y.push_back( sample.coord.y );
+      }
+
+      if ( ++index == size )
+	index = 0;
     }
   }
 
-  if ( count > 0 )
-  { sum /= count;
-    sum /= lineLength;
+  begin.push_back( x.size() );
+
+	/* mean and distances to the line from first to last coordinate in one pass */
+
+  for ( int oi = ((int)objects.size())-1; oi >= 0; --oi )
+  {
+    LidarObject &object( objects[oi] );
+
+    const int first = begin[oi];
+    const int count = begin[oi+1] - first;
+
+    object.curvature = 0.0f;
+    object.scatter   = 0.0f;
+    object.curvePoints.resize( 0 );
+
+    if ( count < 2 )
+      continue;
+
+    const float *px = &x[first];
+    const float *py = &y[first];
+    const float  x0 = px[0];
+    const float  y0 = py[0];
+
+    float dx = px[count-1] - x0;
+    float dy = py[count-1] - y0;
+    float lineLength = sqrtf( dx*dx + dy*dy );
+
+    if ( lineLength > 0.0f )
+    { dx /= lineLength;
+      dy /= lineLength;
+    }
+
+    float sx = 0.0f, sy = 0.0f, scatter = 0.0f;
+
+    for ( int i = 0; i < count; ++i )
+    { sx      += px[i];
+      sy      += py[i];
+      scatter += fabsf( (px[i]-x0) * dy - (py[i]-y0) * dx );
+    }
+
+    object.curvePoints.resize( 3 );
+    object.curvePoints[0] = Vector2D( x0, y0 );
+    object.curvePoints[1] = Vector2D( sx / count, sy / count );
+    object.curvePoints[2] = Vector2D( px[count-1], py[count-1] );
+
+    if ( count > 2 )
+    {
+      object.curvature = curvature( object.curvePoints[0], object.curvePoints[1], object.curvePoints[2] );
+
+      if ( lineLength > 0.0f )
+	object.scatter = scatter / (count-2) / lineLength;
+    }
   }
-  
-  return sum;
 }
 
-static bool
-calcCurvature( float &curvature, LidarSampleBuffer &sampleBuffer, int lowerIndex, int higherIndex, float countWeight=0.5, std::vector<Vector2D> *curvePoints=NULL )
+	/* the index between firstIndex and lastIndex where the two halves of the range
+	   bend most, prefix sums make every candidate O(1). Returns -1 if none bends */
+
+int
+LidarObjectFeatures::splitIndex( LidarSampleBuffer &sampleBuffer, int lowerIndex, int higherIndex, int firstIndex, int lastIndex )
 {
-  curvature = 0;
-  
-  const int numSmoothed = 3;
+  if ( higherIndex < lowerIndex )
+    return -1;
 
-  Vector2D sum;
-  int count = 0;
-  
-  std::vector<Vector2D> smoothed;
-  smoothed.resize( numSmoothed );
-  int smoothedIndex = 0;
-  
-  for ( int angIndex = lowerIndex; angIndex <= higherIndex; ++angIndex )
-  { LidarSample &sample( sampleBuffer[angIndex%sampleBuffer.size()] );
-    if ( sample.isValid() )
-    { 
-      smoothed[smoothedIndex] = Vector2D(sample.coord.x, sample.coord.y);
+  const int size  = sampleBuffer.size();
+  const int range = higherIndex - lowerIndex + 1;
 
-      sum += smoothed[smoothedIndex];
-      
-      count += 1;
-      
-      if ( smoothedIndex == 0 )
-	smoothedIndex = numSmoothed - 1;
-    }
-  }
-  
-  if ( count < 2 )
-    return false;
+  x.resize( 0 );
+  y.resize( 0 );
+  sumX.resize( 1 );
+  sumY.resize( 1 );
+  validCount.resize( range );
 
-  sum /= count;
+  sumX[0] = sumY[0] = 0.0f;
+
+  for ( int k = 0; k < range; ++k )
+  {
+    const LidarSample &sample( sampleBuffer[(lowerIndex+k)%size] );
+
+    if ( sample.isValid() )
+    { x.push_back( sample.coord.x );
+      y.push_back( sample.coord.y );
+      sumX.push_back( sumX.back() + sample.coord.x );
+      sumY.push_back( sumY.back() + sample.coord.y );
+    }
 
-  smoothed[1] = sum;
+    validCount[k] = x.size();
+  }
 
-  if ( count > 2 )
+  auto segmentCurvature = [this]( int lower, int higher, float &curv ) -> bool
   {
-    Vector2D v0( smoothed[1] - smoothed[0] );
-    Vector2D v1( smoothed[2] - smoothed[1] );
+    const int from  = (lower > 0 ? validCount[lower-1] : 0);
+    const int to    = validCount[higher];
+    const int count = to - from;
 
-    v0.normalize();
-    v1.normalize();
+    if ( count < 2 )
+      return false;
 
-    Vector3D V0( v0 );
-    Vector3D V1( v1 );
+    curv = 0.0f;
 
-    Vector3D prod = V0.product( V1 );
+    if ( count > 2 )
+      curv = curvature( Vector2D( x[from], y[from] ),
+			Vector2D( (sumX[to]-sumX[from]) / count, (sumY[to]-sumY[from]) / count ),
+			Vector2D( x[to-1], y[to-1] ) );
 
-    double  angle = prod.length();
-  
-    if ( prod.z < 0 )
-      angle *= -1.0;
+    return true;
+  };
 
-//  printf( "curv1: %g\n", angle );
-    double curv = asin( angle ) / M_PI_2;
-  
-    const double maxCurvature = 0.75;
-    curv /= maxCurvature;
+  float maxCurvature = 0;
+  int   maxIndex     = -1;
 
-    if ( curv > 1.0 )
-      curv = 1.0;
-    else if ( curv < 0.0 )
-      curv = 0.0;
+  if ( firstIndex < lowerIndex )
+    firstIndex = lowerIndex;
+  if ( lastIndex > higherIndex )
+    lastIndex = higherIndex;
 
-    curvature = curv;
+  for ( int index = firstIndex; index <= lastIndex; ++index )
+  {
+    float c1, c2;
+    
+    if ( segmentCurvature( 0, index-lowerIndex, c1 ) && segmentCurvature( index-lowerIndex, range-1, c2 ) )
+    {
+      float curvature = fabsf(c1) + fabsf(c2);
+	
+      if ( curvature > maxCurvature )
+      { maxCurvature = curvature;
+	maxIndex     = index;
+      }
+    }
   }
-  else
-    curvature = 0.0;
-  
-  if ( curvePoints != NULL )
-    *curvePoints = smoothed;
-
-  return true;
-}
 
-void
-LidarObject::calcCurvature( LidarSampleBuffer &sampleBuffer )
-{
-  ::calcCurvature( curvature, sampleBuffer, lowerIndex, higherIndex, 0.5, &curvePoints );
+  return maxIndex;
 }
 
 /***************************************************************************
@@ -1364,13 +1455,16 @@ LidarObjects
 LidarObjects::unscatter( LidarSampleBuffer &sampleBuffer ) const
 {
   LidarObjects objects;
+  LidarObjects scattered( *this );
   
   const float maxLineScatter = 0.75;
 
-  for ( int i = ((int)size())-1; i >= 0; --i )
-  { float lineScatter = (*this)[i].lineScatter( sampleBuffer );
+  features().extract( scattered, sampleBuffer );
+
+  for ( int i = ((int)scattered.size())-1; i >= 0; --i )
+  { float lineScatter = scattered[i].scatter;
     if ( lineScatter <= maxLineScatter )
-      objects.push_back( LidarObject( (*this)[i] ) );
+      objects.push_back( scattered[i] );
     else if ( g_Verbose > 0 )
       Lidar::info( "removing object %d with linescatter %g > %g", i, lineScatter, maxLineScatter );
   }
@@ -1381,8 +1475,14 @@ LidarObjects::unscatter( LidarSampleBuffer &sampleBuffer ) const
 void
 LidarObjects::calcCurvature( LidarSampleBuffer &sampleBuffer )
 {
-  for ( int i = ((int)size())-1; i >= 0; --i )
-    (*this)[i].calcCurvature( sampleBuffer );
+  features().extract( *this, sampleBuffer );
+}
+
+LidarObjectFeatures &
+LidarObjects::features()
+{
+  static thread_local LidarObjectFeatures arena;
+  return arena;
 }
 
 
@@ -1744,6 +1844,370 @@ LidarSampleBuffer::write( const char *fileName )
   return write( stream );
 }
 
+/***************************************************************************
+*** 
+*** LidarSampleColumns
+***
+****************************************************************************/
+
+#if defined(__SSE2__) || defined(__ARM_NEON)
+
+#define LIDAR_SIMD 1
+
+#if defined(__SSE2__)
+
+typedef __m128  simd4f;
+typedef __m128i simd4i;
+
+static inline simd4f simdLoad  ( const float *p )		{ return _mm_loadu_ps( p ); }
+static inline void   simdStore ( float *p, simd4f v )		{ _mm_storeu_ps( p, v ); }
+static inline void   simdStore ( int *p, simd4i v )		{ _mm_storeu_si128( (simd4i*)p, v ); }
+static inline simd4f simdSet   ( float v )			{ return _mm_set1_ps( v ); }
+static inline simd4i simdSetI  ( int v )			{ return _mm_set1_epi32( v ); }
+static inline simd4f simdMul   ( simd4f a, simd4f b )		{ return _mm_mul_ps( a, b ); }
+static inline simd4f simdMadd  ( simd4f a, simd4f b, simd4f c ) { return _mm_add_ps( _mm_mul_ps( a, b ), c ); }
+static inline simd4i simdTrunc ( simd4f v )			{ return _mm_cvttps_epi32( v ); }
+static inline simd4i simdAndI  ( simd4i a, simd4i b )		{ return _mm_and_si128( a, b ); }
+static inline simd4i simdSubI  ( simd4i a, simd4i b )		{ return _mm_sub_epi32( a, b ); }
+static inline simd4i simdGtI   ( simd4i a, simd4i b )		{ return _mm_cmpgt_epi32( a, b ); }
+static inline simd4f simdAdd   ( simd4f a, simd4f b )		{ return _mm_add_ps( a, b ); }
+static inline simd4f simdGt    ( simd4f a, simd4f b )		{ return _mm_cmpgt_ps( a, b ); }
+static inline simd4f simdAnd   ( simd4f a, simd4f b )		{ return _mm_and_ps( a, b ); }
+static inline simd4f simdOr    ( simd4f a, simd4f b )		{ return _mm_or_ps( a, b ); }
+static inline simd4f simdAndNot( simd4f a, simd4f b )		{ return _mm_andnot_ps( b, a ); }	// a & ~b
+static inline int    simdMoveMask( simd4f m )			{ return _mm_movemask_ps( m ); }
+
+#else
+
+typedef float32x4_t simd4f;
+typedef int32x4_t   simd4i;
+
+static inline simd4f simdLoad  ( const float *p )		{ return vld1q_f32( p ); }
+static inline void   simdStore ( float *p, simd4f v )		{ vst1q_f32( p, v ); }
+static inline void   simdStore ( int *p, simd4i v )		{ vst1q_s32( p, v ); }
+static inline simd4f simdSet   ( float v )			{ return vdupq_n_f32( v ); }
+static inline simd4i simdSetI  ( int v )			{ return vdupq_n_s32( v ); }
+static inline simd4f simdMul   ( simd4f a, simd4f b )		{ return vmulq_f32( a, b ); }
+static inline simd4f simdMadd  ( simd4f a, simd4f b, simd4f c ) { return vmlaq_f32( c, a, b ); }
+static inline simd4i simdTrunc ( simd4f v )			{ return vcvtq_s32_f32( v ); }
+static inline simd4i simdAndI  ( simd4i a, simd4i b )		{ return vandq_s32( a, b ); }
+static inline simd4i simdSubI  ( simd4i a, simd4i b )		{ return vsubq_s32( a, b ); }
+static inline simd4i simdGtI   ( simd4i a, simd4i b )		{ return vreinterpretq_s32_u32( vcgtq_s32( a, b ) ); }
+static inline simd4f simdAdd   ( simd4f a, simd4f b )		{ return vaddq_f32( a, b ); }
+static inline simd4f simdGt    ( simd4f a, simd4f b )		{ return vreinterpretq_f32_u32( vcgtq_f32( a, b ) ); }
+static inline simd4f simdAnd   ( simd4f a, simd4f b )		{ return vreinterpretq_f32_u32( vandq_u32( vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b) ) ); }
+static inline simd4f simdOr    ( simd4f a, simd4f b )		{ return vreinterpretq_f32_u32( vorrq_u32( vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b) ) ); }
+static inline simd4f simdAndNot( simd4f a, simd4f b )		{ return vreinterpretq_f32_u32( vbicq_u32( vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b) ) ); }	// a & ~b
+static inline int    simdMoveMask( simd4f m )
+{ uint32x4_t bits = vshrq_n_u32( vreinterpretq_u32_f32(m), 31 );
+  return vgetq_lane_u32( bits, 0 ) | (vgetq_lane_u32( bits, 1 ) << 1) | (vgetq_lane_u32( bits, 2 ) << 2) | (vgetq_lane_u32( bits, 3 ) << 3);
+}
+
+#endif
+
+#endif
+
+void
+LidarSampleColumns::reserve( int capacity )
+{
+  if ( capacity <= (int)angle.size() )
+    return;
+
+  angle.resize( capacity );
+  distance.resize( capacity );
+  x.resize( capacity );
+  y.resize( capacity );
+  quality.resize( capacity );
+  angIndex.resize( capacity );
+}
+
+void
+LidarSampleColumns::convert( const LidarRawSampleBuffer &nodes, double char1, double char2, const LidarBinDirections &directions, int numSamples )
+{
+  size = nodes.size();
+  reserve( size );
+
+  const float angleScale = M_PI_2 / (1 << 14);
+  const float distScale  = 1.0 / 1000.0 / 4.0;
+
+  for ( int i = size-1; i >= 0; --i )
+  { const LidarRawSample &node( nodes[i] );
+    angle[i]    = node.angle_z_q14 * angleScale;
+    distance[i] = node.dist_mm_q2  * distScale;
+    quality[i]  = node.quality;
+  }
+
+  const float c1 	 = char1;
+  const float c2 	 = char2;
+  const float indexScale = (numSamples-1) / (2*M_PI);
+
+  int i = 0;
+
+#if LIDAR_SIMD
+  const simd4f vc1   = simdSet( c1 );
+  const simd4f vc2   = simdSet( c2 );
+  const simd4f vis   = simdSet( indexScale );
+  const simd4f vhalf = simdSet( 0.5f );
+  const simd4i vnm1  = simdSetI( numSamples-1 );
+  const simd4i vn    = simdSetI( numSamples );
+
+  for ( ; i+4 <= size; i += 4 )
+  {
+    simd4f a = simdLoad( &angle[i] );
+    simd4f d = simdLoad( &distance[i] );
+
+    d = simdMul( d, simdMadd( vc2, d, vc1 ) );
+
+    simd4i index = simdTrunc( simdMadd( a, vis, vhalf ) );
+    index = simdSubI( index, simdAndI( simdGtI( index, vnm1 ), vn ) );
+
+    simdStore( &distance[i], d );
+    simdStore( &angIndex[i], index );
+  }
+#endif
+
+  for ( ; i < size; ++i )
+  {
+    float a = angle[i];
+    float d = distance[i];
+
+    int index = (int)(a * indexScale + 0.5f);
+    if ( index >= numSamples )
+      index -= numSamples;
+
+    distance[i] = d * (c1 + c2 * d);
+    angIndex[i] = index;
+  }
+
+      /* world coordinates by the per bin directions of the device matrix */
+  const Vector2D *dir = directions.dir.data();
+  const float     ox  = directions.origin.x;
+  const float     oy  = directions.origin.y;
+
+  for ( i = size-1; i >= 0; --i )
+  { const Vector2D &d( dir[angIndex[i]] );
+    x[i] = ox + distance[i] * d.x;
+    y[i] = oy + distance[i] * d.y;
+  }
+}
+
+/***************************************************************************
+*** 
+*** LidarBinDirections
+***
+****************************************************************************/
+
+void
+LidarBinDirections::update( const Matrix3H &matrix, int numSamples )
+{
+  dir.resize( numSamples );
+
+  origin = Vector2D( matrix.w.x, matrix.w.y );
+
+      /* inverse of LidarDevice::angIndexByAngle() */
+  const double angleStep = 2*M_PI / (numSamples-1);
+
+  for ( int angIndex = numSamples-1; angIndex >= 0; --angIndex )
+  {
+    double angle = angIndex * angleStep;
+    float  dx    = sin( angle );
+    float  dy    = cos( angle );
+
+    dir[angIndex] = Vector2D( matrix.x.x * dx + matrix.y.x * dy,
+			      matrix.x.y * dx + matrix.y.y * dy );
+  }
+}
+
+/***************************************************************************
+*** 
+*** LidarSampleHistory
+***
+****************************************************************************/
+
+void
+LidarSampleHistory::setDepth( int depth, int minCount )
+{
+  if ( depth < 2 )
+    depth = 2;
+  else if ( depth > maxDepth )
+    depth = maxDepth;
+
+  if ( minCount < 1 )
+    minCount = 1;
+  else if ( minCount > depth-1 )
+    minCount = depth-1;
+
+  this->depth    = depth;
+  this->minCount = minCount;
+
+      /* previous depth-1 frames, the current frame is checked by LidarSample::isValid() */
+  mask = (depth == maxDepth ? ~0u : ((1u << depth) - 1)) & ~1u;
+}
+
+void
+LidarSampleHistory::resize( int numSamples )
+{
+  noise.assign( numSamples, 0 );
+}
+
+void
+LidarSampleHistory::push( const LidarSampleColumns &columns, int minQuality )
+{
+  uint32_t *bits = noise.data();
+
+  for ( int i = ((int)noise.size())-1; i >= 0; --i )
+    bits[i] <<= 1;
+
+      /* same order as the scatter in LidarDevice::scan(), the lowest node index wins a bin */
+  for ( int i = columns.size-1; i >= 0; --i )
+  { uint32_t &b( bits[columns.angIndex[i]] );
+    b = (b & ~1u) | (columns.quality[i] <= minQuality ? 1u : 0u);
+  }
+}
+
+/***************************************************************************
+*** 
+*** LidarEnvMixture
+***
+****************************************************************************/
+
+static const float envMixtureMinVar = 0.01 * 0.01;
+
+void
+LidarEnvMixture::resize( int numSamples )
+{
+  mean.assign  ( numSamples*numModes, 0.0f );
+  var.assign   ( numSamples*numModes, envMixtureMinVar );
+  weight.assign( numSamples*numModes, 0.0f );
+}
+
+void
+LidarEnvMixture::seed( int angIndex, float distance )
+{
+  clear( angIndex );
+
+  mean  [angIndex*numModes] = distance;
+  var   [angIndex*numModes] = envMixtureMinVar;
+  weight[angIndex*numModes] = 1.0f;
+}
+
+void
+LidarEnvMixture::clear( int angIndex )
+{
+  for ( int k = numModes-1; k >= 0; --k )
+    weight[angIndex*numModes+k] = 0.0f;
+}
+
+	/* learning rate for the frame at timestamp */
+float
+LidarEnvMixture::alpha( uint64_t timestamp )
+{
+  uint64_t last = lastTime;
+  lastTime = timestamp;
+
+  if ( last == 0 || timestamp <= last || learnSec <= 0.0 )
+    return 0.0f;
+
+  float a = (timestamp - last) / (1000.0 * learnSec);
+
+  return (a > 1.0f ? 1.0f : a);
+}
+
+void
+LidarEnvMixture::update( int angIndex, float distance, float alpha, float minTolerance )
+{
+  float *m = &mean  [angIndex*numModes];
+  float *v = &var   [angIndex*numModes];
+  float *w = &weight[angIndex*numModes];
+
+  int   match = -1;
+  float best  = INFINITY;
+
+  for ( int k = numModes-1; k >= 0; --k )
+  { if ( w[k] > 0.0f )
+    { float diff = fabsf( distance - m[k] );
+      float tol  = std::max( minTolerance, matchSigma * sqrtf( v[k] ) );
+      if ( diff < tol && diff < best )
+      { match = k;
+	best  = diff;
+      }
+    }
+  }
+
+  for ( int k = numModes-1; k >= 0; --k )
+    w[k] *= 1.0f - alpha;
+
+  if ( match >= 0 )
+  {
+    w[match] += alpha;
+
+    float rho  = (w[match] > alpha ? alpha / w[match] : 1.0f);
+    float diff = distance - m[match];
+
+    m[match] += rho * diff;
+    v[match] += rho * (diff*diff - v[match]);
+    if ( v[match] < envMixtureMinVar )
+      v[match] = envMixtureMinVar;
+  }
+  else if ( alpha > 0.0f )	/* replace the weakest mode */
+  {
+    int weakest = 0;
+    for ( int k = numModes-1; k > 0; --k )
+      if ( w[k] < w[weakest] )
+	weakest = k;
+
+    m[weakest] = distance;
+    v[weakest] = minTolerance * minTolerance;
+    w[weakest] = alpha;
+  }
+}
+
+bool
+LidarEnvMixture::isBackground( int angIndex, float distance, float minTolerance ) const
+{
+  const float *m = &mean  [angIndex*numModes];
+  const float *v = &var   [angIndex*numModes];
+  const float *w = &weight[angIndex*numModes];
+
+  float farthest = -1.0f;
+
+  for ( int k = numModes-1; k >= 0; --k )
+  { if ( w[k] >= minWeight )
+    { float tol = std::max( minTolerance, matchSigma * sqrtf( v[k] ) );
+      if ( fabsf( distance - m[k] ) < tol )
+	return true;
+      if ( m[k] > farthest )
+	farthest = m[k];
+    }
+  }
+
+  return farthest >= 0.0f && distance > farthest;
+}
+
+/***************************************************************************
+*** 
+*** LidarFrameSignal
+***
+****************************************************************************/
+
+void
+LidarFrameSignal::notify()
+{
+  mutex.lock();
+  count += 1;
+  mutex.unlock();
+
+  cond.notify_all();
+}
+
+bool
+LidarFrameSignal::wait( const std::function<bool()> &ready, uint64_t timeoutUSec )
+{
+  std::unique_lock<std::mutex> lock( mutex );
+
+  return cond.wait_for( lock, std::chrono::microseconds(timeoutUSec), ready );
+}
+
 /***************************************************************************
 *** 
 *** LidarDevice
@@ -1786,7 +2250,16 @@ LidarDevice::LidarDevice()
     envSamples		( numSamples ),
     envRawSamples	( numSamples ),
     envErodedSamples	( numSamples ),
+    envFilteredSamples	( numSamples ),
     envDSamples		( numSamples ), 
+    envDistance		( numSamples, INFINITY ),
+    envDistanceQuality	( 0 ),
+    scanDistance	( numSamples, 0.0f ),
+    scanQuality		( numSamples, -1.0f ),
+    scanValidMask	( (numSamples+31)/32, 0 ),
+    envDirty		( numSamples, 0 ),
+    envDirtyBins	(),
+    envFilterValid	( false ),
     envTimeStamps       ( new uint64_t[numSamples] ),
     accumSamples	( numSamples ),
     rpSerialDrvStopped	( NULL ),
@@ -1807,6 +2280,12 @@ LidarDevice::LidarDevice()
     matrixInverse	(),
     deviceMatrix	(),
     viewMatrix		(),
+    objectsFrameValid	( false ),
+    scanReceiveTime	( 0 ),
+    publishedFrames	( 0 ),
+    framesActive	( false ),
+    consumedFrames	( 0 ),
+    trackedReceiveTime	( 0 ),
     mutex		(),
     thread		( NULL ),
     exitThread		( false ),
@@ -1829,15 +2308,27 @@ LidarDevice::LidarDevice()
     objectMinExtent 	( 0.1 ),
     objectMaxExtent 	( 0.0 ),
     objectTrackDistance	( 0.5 ),
+    objectOptimalAssignment( true ),
     doObjectDetection   ( false ),
     doObjectTracking    ( false ),
     doEnvAdaption       ( false ),
     scanOnce		( false ),
+    scanFrameIndex	( 0 ),
+    computeSlot		( g_DeviceList.size() ),
+    scanProcessing	( false ),
     reopenTime          ( 0 ),
     startTime           ( getmsec() )
 
 {
   info.spec.maxRange = 100;
+
+  binDirections.update( matrix, numSamples );
+  sampleHistory.resize( numSamples );
+  envMixture.resize( numSamples );
+
+  scanFrames[0].nodes.reserve( LidarRawSampleBuffer::nodeCapacity );
+  scanFrames[1].nodes.reserve( LidarRawSampleBuffer::nodeCapacity );
+  scanPoints.reserve( LidarRawSampleBuffer::nodeCapacity );
   
   g_DeviceList.push_back( this );
 }
@@ -4066,6 +4557,7 @@ LidarDevice::operator *=( const Matrix3H &m )
   if ( envValid )
   { envSamples    *= m;
     envRawSamples *= m;
+    envFilterValid = false;
   }
   
   if ( isAccumulating )
@@ -4075,6 +4567,8 @@ LidarDevice::operator *=( const Matrix3H &m )
   matrix        = m * matrix;
   matrixInverse = matrixInverse * m.inverse();
 
+  binDirections.update( matrix, numSamples );
+
   return *this;
 }
 
@@ -4090,6 +4584,8 @@ LidarDevice::setMatrix( const Matrix3H &m )
 
   matrix        = m;
   matrixInverse = m.inverse();
+
+  binDirections.update( matrix, numSamples );
 }
 
 
@@ -4130,6 +4626,9 @@ LidarDevice::isEnvSample( LidarSample &sample ) const
 {
   int angIndex = angIndexByAngle( sample.angle );
 
+  if ( envMixture.enabled )
+    return useEnv && envMixture.isBackground( angIndex, sample.distance, envThreshold );
+
   if ( envValid && useEnv && envSamples[angIndex].quality > info.spec.minQuality )
   { if ( sample.distance > envSamples[angIndex].distance - envThreshold )
       return true;
@@ -4148,38 +4647,111 @@ LidarDevice::isTempNoiseSample( int angIndex ) const
   return false;
 #endif
 
-  for ( int i = 1; i < numSampleBuffers; ++i )
-  { 
-    LidarSampleBuffer &sampleBuf( sampleBuffer(i) );
-    
-    LidarSample &sample( sampleBuf[sampleBuf[angIndex].sourceIndex] );
-    if ( sample.sourceQuality <= info.spec.minQuality )
-      return true;
-  }
-
-  return false;
+  return sampleHistory.isNoise( angIndex );
 }
 
 
-bool
-LidarDevice::scanValid( int i ) const
+void
+LidarDevice::updateEnvDistance( int first, int count )
 {
-  LidarSample &sample( sampleBuffer(0)[i] );
-  if ( !sample.isValid() )
-    return false;
-    
-  if ( useTemporalDenoise && isTempNoiseSample(i) )
-    return false;
-  
-  if ( isEnvSample( sample ) )
-    return false;
+  if ( count < 0 || envDistanceQuality != info.spec.minQuality )
+  { first = 0;
+    count = numSamples;
+    envDistanceQuality = info.spec.minQuality;
+  }
 
-  return true;
+  for ( int k = count-1; k >= 0; --k )
+  { const int angIndex = this->angIndex( first+k );
+    const LidarSample &envSample( envSamples[angIndex] );
+    envDistance[angIndex] = (envSample.quality > info.spec.minQuality ? envSample.distance : INFINITY);
+  }
+}
+
+	/* validity of the current scan in one pass over the dense per bin arrays,
+	   same as isEnvSample() and isTempNoiseSample() on the samples */
+void
+LidarDevice::classifyScan()
+{
+  if ( envDistanceQuality != info.spec.minQuality )
+    updateEnvDistance();
+
+  const bool  checkEnv   = envValid && useEnv;
+  const bool  checkNoise = useTemporalDenoise;
+  const bool  checkRange = g_UseSimulationRange;
+  const float thres      = envThreshold;
+  const float maxRange   = info.spec.maxRange;
+
+  const float *distance = scanDistance.data();
+  const float *quality  = scanQuality.data();
+  const float *envDist  = envDistance.data();
+  uint32_t    *mask     = scanValidMask.data();
+
+  int i = 0;
+
+  if ( envMixture.enabled && useEnv )
+  {
+    for ( ; i < numSamples; ++i )
+    {
+      bool valid = quality[i] > 0.0f && !envMixture.isBackground( i, distance[i], thres );
+
+      if ( (i & 31) == 0 )
+	mask[i >> 5] = 0;
+      if ( valid )
+	mask[i >> 5] |= 1u << (i & 31);
+    }
+  }
+
+#if LIDAR_SIMD
+  const simd4f vzero  = simdSet( 0.0f );
+  const simd4f vthres = simdSet( thres );
+  const simd4f vrange = simdSet( maxRange );
+  const simd4f vinf   = simdSet( INFINITY );
+
+  for ( ; i+4 <= numSamples; i += 4 )
+  {
+    simd4f d     = simdLoad( &distance[i] );
+    simd4f valid = simdGt( simdLoad( &quality[i] ), vzero );
+
+    if ( checkEnv )
+    { simd4f e   = simdLoad( &envDist[i] );
+      simd4f env = simdGt( simdAdd( d, vthres ), e );
+      if ( checkRange )
+	env = simdOr( env, simdAnd( simdGt( d, vrange ), simdGt( vinf, e ) ) );
+      valid = simdAndNot( valid, env );
+    }
+
+    if ( (i & 31) == 0 )
+      mask[i >> 5] = 0;
+    mask[i >> 5] |= (uint32_t) simdMoveMask( valid ) << (i & 31);
+  }
+#endif
+
+  for ( ; i < numSamples; ++i )
+  {
+    bool valid = quality[i] > 0.0f;
+
+    if ( checkEnv && valid && envDist[i] != INFINITY )
+      valid = !(distance[i] + thres > envDist[i] || (checkRange && distance[i] > maxRange));
+
+    if ( (i & 31) == 0 )
+      mask[i >> 5] = 0;
+    if ( valid )
+      mask[i >> 5] |= 1u << (i & 31);
+  }
+
+  if ( checkNoise )
+  { for ( i = numSamples-1; i >= 0; --i )
+      if ( isTempNoiseSample( i ) )
+	mask[i >> 5] &= ~(1u << (i & 31));
+  }
 }
 
 bool
 LidarDevice::isValid( int i ) const
 {
+  if ( !isAccumulating )
+    return scanValid( i );
+
   LidarSample &sample( sampleBuffer()[i] );
   if ( !sample.isValid() )
     return false;
@@ -4372,10 +4944,12 @@ LidarDevice::envChanged()
 
 
 void
-LidarDevice::erodeEnv( LidarSampleBuffer &srcSamples, LidarSampleBuffer &dstSamples, int steps )
+LidarDevice::erodeEnv( LidarSampleBuffer &srcSamples, LidarSampleBuffer &dstSamples, int steps, int first, int count )
 {
-  for ( int angIndex = numSamples-1; angIndex >= 0; --angIndex )
+  for ( int k = count-1; k >= 0; --k )
   {
+    const int angIndex = this->angIndex( first+k );
+
     LidarSample &dstSample ( dstSamples[angIndex] );
     LidarSample &srcSample ( srcSamples[angIndex] );
     
@@ -4409,19 +4983,18 @@ LidarDevice::erodeEnv( LidarSampleBuffer &srcSamples, LidarSampleBuffer &dstSamp
 }
 
 void
-LidarDevice::smoothEnv( LidarSampleBuffer &samples, int steps )
+LidarDevice::smoothEnv( const LidarSampleBuffer &srcSamples, LidarSampleBuffer &dstSamples, int steps, int first, int count )
 {
-  float distances[numSamples];
-
   double stepsm1 = (steps <= 1 ? 1 : steps-1);
 
   const float minDistance = envFilterMinDistance;
 
-  for ( int angIndex = numSamples-1; angIndex >= 0; --angIndex )
+  for ( int k = count-1; k >= 0; --k )
   {
-    LidarSample &sample( samples[angIndex] );
+    const int angIndex = this->angIndex( first+k );
 
-    distances[angIndex] = sample.distance;
+    const LidarSample &sample( srcSamples[angIndex] );
+    float result;
 
     if ( sample.quality > info.spec.minQuality )
     {
@@ -4432,8 +5005,8 @@ LidarDevice::smoothEnv( LidarSampleBuffer &samples, int steps )
       int count = 1;
       for ( int i = steps-1; i > 0; --i )
       { 
-	const LidarSample &prevSample( samples[addAngIndex(angIndex,-i)] );
-	const LidarSample &nextSample( samples[addAngIndex(angIndex,+i)] );
+	const LidarSample &prevSample( srcSamples[addAngIndex(angIndex,-i)] );
+	const LidarSample &nextSample( srcSamples[addAngIndex(angIndex,+i)] );
 	
 	double alpha = 1.0 - (0.3*i) / stepsm1;
 
@@ -4453,55 +5026,114 @@ LidarDevice::smoothEnv( LidarSampleBuffer &samples, int steps )
       if ( distance < 0.01 )
 	distanceSum = 100 * count;
       
-
-      distances[angIndex] = distanceSum / count;
+      result = distanceSum / count;
     }
     else
-      distances[angIndex] = 1024;
-  }
-  
-  for ( int angIndex = numSamples-1; angIndex >= 0; --angIndex )
-  {
-    LidarSample &sample( samples[angIndex] );
+      result = 1024;
 
-    sample.distance = distances[angIndex];
+    LidarSample &dstSample( dstSamples[angIndex] );
 
-    Vector3D coord( sample.distance * sin( sample.angle ), sample.distance * cos( sample.angle ), 0.0 );
-    sample.coord = matrix * coord;
+    dstSample          = sample;
+    dstSample.distance = result;
+    dstSample.coord    = binDirections.coord( angIndex, result );
   }
 }
 
 void
-LidarDevice::processEnv()
+LidarDevice::markEnvDirty( int angIndex )
+{
+  if ( !envDirty[angIndex] )
+  { envDirty[angIndex] = 1;
+    envDirtyBins.push_back( angIndex );
+  }
+}
+
+	/* filters only windows around dirty bins if onlyDirty, erode and smooth each reach steps-1 bins */
+void
+LidarDevice::processEnv( bool onlyDirty )
 {
   int steps = round( envFilterSize/360.0 * numSamples);
 
 //	  printf( "LidarDevice:filterSteps = %d\n", steps );
 
+  const int reach = (steps > 1 ? steps-1 : 0);
+
+  if ( onlyDirty && (!envFilterValid || envDirtyBins.size() * (4*reach+1) >= numSamples) )
+    onlyDirty = false;
+
+  if ( onlyDirty && envDirtyBins.size() == 0 )
+    return;
+
   if ( info.detectedDeviceType == "ms200" || info.detectedDeviceType == "st27" ) // hack eroding does not work for this for a magic reason
   {
     lock();
   
-    for ( int angIndex = numSamples-1; angIndex >= 0; --angIndex )
-    { LidarSample &sample( envSamples[angIndex] );
-      sample = envRawSamples[angIndex];
-      Vector3D coord( sample.distance * sin( sample.angle ), sample.distance * cos( sample.angle ), 0.0 );
-      sample.coord = matrix * coord;
+    if ( onlyDirty )
+    { for ( int d = ((int)envDirtyBins.size())-1; d >= 0; --d )
+      { int angIndex = envDirtyBins[d];
+	LidarSample &sample( envSamples[angIndex] );
+	sample = envRawSamples[angIndex];
+	sample.coord = binDirections.coord( angIndex, sample.distance );
+	updateEnvDistance( angIndex, 1 );
+      }
+    }
+    else
+    { for ( int angIndex = numSamples-1; angIndex >= 0; --angIndex )
+      { LidarSample &sample( envSamples[angIndex] );
+	sample = envRawSamples[angIndex];
+	sample.coord = binDirections.coord( angIndex, sample.distance );
+      }
+      updateEnvDistance();
+    }
+    unlock();
+  }
+  else if ( onlyDirty )
+  {
+	/* merge dirty bins to runs [first,last], runs closer than both windows are joined */
+    std::sort( envDirtyBins.begin(), envDirtyBins.end() );
+
+    std::vector<int> runs;
+    for ( int d = 0; d < envDirtyBins.size(); ++d )
+    { if ( runs.size() > 0 && envDirtyBins[d] - runs.back() <= 4*reach+1 )
+	runs.back() = envDirtyBins[d];
+      else
+      { runs.push_back( envDirtyBins[d] );
+	runs.push_back( envDirtyBins[d] );
+      }
+    }
+
+    for ( int r = 0; r < runs.size(); r += 2 )
+      erodeEnv( envRawSamples, envErodedSamples, steps, runs[r]-reach, runs[r+1]-runs[r]+1 + 2*reach );
+
+    for ( int r = 0; r < runs.size(); r += 2 )
+      smoothEnv( envErodedSamples, envFilteredSamples, steps, runs[r]-2*reach, runs[r+1]-runs[r]+1 + 4*reach );
+
+    lock();
+
+    for ( int r = 0; r < runs.size(); r += 2 )
+    { const int count = runs[r+1]-runs[r]+1 + 4*reach;
+      for ( int k = 0; k < count; ++k )
+      { const int angIndex = this->angIndex( runs[r]-2*reach+k );
+	envSamples[angIndex] = envFilteredSamples[angIndex];
+      }
+      updateEnvDistance( runs[r]-2*reach, count );
     }
+
     unlock();
   }
   else
   {
-    erodeEnv ( envRawSamples, envErodedSamples, steps );
-    smoothEnv( envErodedSamples, steps );
+    erodeEnv ( envRawSamples,    envErodedSamples,   steps, 0, numSamples );
+    smoothEnv( envErodedSamples, envFilteredSamples, steps, 0, numSamples );
 
-    LidarSampleBuffer &erodedSamples( envErodedSamples );
+    LidarSampleBuffer &filteredSamples( envFilteredSamples );
     LidarSampleBuffer &eSamples( envSamples );
 
     lock();
   
     for ( int angIndex = numSamples-1; angIndex >= 0; --angIndex )
-      eSamples[angIndex] = erodedSamples[angIndex];
+      eSamples[angIndex] = filteredSamples[angIndex];
+    updateEnvDistance();
 
   /*
   for ( int angIndex = numSamples-1; angIndex >= 0; --angIndex )
@@ -4510,7 +5142,24 @@ LidarDevice::processEnv()
   */
     unlock();
   }
+
+  if ( !onlyDirty )
+  { envFilterValid = true;
+
+    if ( envMixture.enabled )
+    { for ( int angIndex = numSamples-1; angIndex >= 0; --angIndex )
+      { if ( envSamples[angIndex].quality > info.spec.minQuality )
+	  envMixture.seed( angIndex, envSamples[angIndex].distance );
+	else
+	  envMixture.clear( angIndex );
+      }
+    }
+  }
   
+  for ( int d = ((int)envDirtyBins.size())-1; d >= 0; --d )
+    envDirty[envDirtyBins[d]] = 0;
+  envDirtyBins.resize( 0 );
+
   envValid = true;  
 }
 
@@ -4560,12 +5209,17 @@ LidarDevice::adaptEnv()
 
 	  float ez = eSample.distance;
 	  if ( ez+thres < z )
-	    eSample.distance = z-thres;
+	  { eSample.distance = z-thres;
+	    markEnvDirty( angIndex );
+	  }
 	  
 	  envTimeStamps[i] = timeStamp;
 	}
 	else if ( timeStamp - envTimeStamps[i] > environmentDepthTime )
+	{ if ( eSample.distance != sample.distance || eSample.quality != sample.quality || eSample.angle != sample.angle )
+	    markEnvDirty( angIndex );
 	  eSample = sample;
+	}
       }
     }
   }
@@ -4613,6 +5267,7 @@ LidarDevice::updateEnv()
 	envSample.distance = rawSample.distance = sample.distance;
 	envSample.coord    = rawSample.coord    = sample.coord;
 	envTimeStamps[i]   = timeStamp;
+	updateEnvDistance( angIndex, 1 );
       }
     }
   }
@@ -4635,7 +5290,8 @@ LidarDevice::scanEnv()
     envSample.distance = rawSample.distance = info.spec.maxRange*10;
     envTimeStamps[i]   = timeStamp;
   }
-
+  updateEnvDistance();
+  envFilterValid = false;
 
   useOutEnvBak = useOutEnv;
   setUseOutEnv( false );
@@ -4677,6 +5333,7 @@ LidarDevice::readEnv( const char *path )
   lock();
   
   bool result = envRawSamples.read( fileName.c_str() );
+  envFilterValid = false;
 
   for ( int i = 0; i < (int)numSamples ; ++i )
     envTimeStamps[i] = timeStamp;
@@ -4726,6 +5383,8 @@ LidarDevice::resetEnv()
     envSamples[i].angle    = angleByAngIndex( i );
     envSamples[i].distance = info.spec.maxRange * 10;
   }
+  updateEnvDistance();
+  envFilterValid = false;
 
   unlock();
 
@@ -4853,23 +5512,7 @@ LidarDevice::addDetectedObject( LidarObjects &objects, int lowerIndex, int highe
       int lIndex 	   = round( lowerIndex + lower  * (higherIndex-lowerIndex) );
       int hIndex 	   = round( lowerIndex + higher * (higherIndex-lowerIndex) );
    
-      float maxCurvature = 0;
-      int maxIndex = -1;
-
-      for ( int index = lIndex; index <= hIndex; ++index )
-      {
-	float c1, c2;
-    
-	if ( calcCurvature( c1, samples, lowerIndex, index, 0.0 ) && calcCurvature( c2, samples, index, higherIndex, 0.0 ) )
-        {
-	  float curvature = fabsf(c1) + fabsf(c2);
-	
-	  if ( curvature > maxCurvature )
-          { maxCurvature = curvature;
-	    maxIndex     = index;
-	  }
-	}
-      }
+      int maxIndex = objectFeatures.splitIndex( samples, lowerIndex, higherIndex, lIndex, hIndex );
 
       if ( maxIndex >= 0 )
       {
@@ -4926,123 +5569,86 @@ LidarDevice::addDetectedObject( LidarObjects &objects, int lowerIndex, int highe
 }
 
 void
-LidarDevice::detectObjects()
+LidarDevice::addDetectedObject( LidarObjects &objects, const LidarSampleSpan &span )
 {
-  LidarObjects detectedObjects;
   LidarSampleBuffer &samples( sampleBuffer() );
 
-  int oidcount = 1;
-  int lastoid  = oidcount;
+  int higherIndex = angIndex( span.higherIndex );
 
-  LidarSample *lastSample = NULL;
+  float extent = samples[span.lowerIndex].coord.distance( samples[higherIndex].coord );
 
-  for ( int angIndex = numSamples-1; angIndex >= 0; --angIndex )
-  {
-    LidarSample &sample( samples[angIndex] );
+  if ( extent >= objectMinExtent )
+    addDetectedObject( objects, span.lowerIndex, higherIndex, extent, span.closest );
+}
 
-    if ( !isValid( angIndex ) )
-      sample.oid = 0;
-    else
-    {
-      if ( lastSample != NULL )
-      { float distance = sample.coord.distance( lastSample->coord );
-	if ( distance > objectMaxDistance )
-	  lastoid = (oidcount+=1);
-      }
-      sample.oid = lastoid;
+void
+LidarDevice::detectObjects()
+{
+  LidarObjects detectedObjects;
+  LidarSampleBuffer &samples( sampleBuffer() );
 
-      lastSample = &sample;
-    }
-  }
+  bool checkEnv   = envValid && useEnv;	// accumulated samples are not temporally denoised, scanValid() is
 
-      // make object ids continuous at 0 degree
-  for ( int angIndex = numSamples-1; angIndex >= 0; --angIndex )
-  {
-    LidarSample &sample( samples[angIndex] );
+      // segment the valid samples in a single walk, the first span stays open
+      // until the walk came round, so an object at 0 degree is not split
 
-    if ( sample.oid == 0 )
-      break;
-    
-    LidarSample &prevSample( samples[addAngIndex(angIndex,1)] );
-	
-    if ( prevSample.oid == 0 )
-      break;
-    
-    sample.oid = prevSample.oid;
-  }
+  sampleSpans.resize( 0 );
 
-      // remove too small objects
-  
-  int indexOffset = -1;
-  
-      // search first sample
-  for ( int angIndex = 0; angIndex < numSamples/2; ++angIndex )
+  LidarSample *lastSample = NULL;
+  int oid = 0;
+
+  for ( int angIndex = 0; angIndex < numSamples; ++angIndex )
   {
     LidarSample &sample( samples[angIndex] );
-    if ( sample.oid != 0 )
-    { if ( indexOffset == -1 || samples[indexOffset].oid == sample.oid ) 
-	indexOffset = angIndex;
-      else
-	break;
+
+    if ( isAccumulating ? (!sample.isValid() || (checkEnv && isEnvSample( sample ))) : !scanValid( angIndex ) )
+    { sample.oid = 0;
+      continue;
     }
-  }
 
-//  printf( "-----\n" );
-  
+    if ( lastSample == NULL || sample.coord.distance( lastSample->coord ) > objectMaxDistance )
+    {
+      if ( sampleSpans.size() > 1 )
+	addDetectedObject( detectedObjects, sampleSpans.back() );
 
-  int lowerAngIndex  = -1;
-  int higherAngIndex = -1;
+      sampleSpans.push_back( LidarSampleSpan( angIndex, sample.distance ) );
+      oid += 1;
+    }
+    else
+    {
+      LidarSampleSpan &span( sampleSpans.back() );
+      span.higherIndex = angIndex;
+      if ( sample.distance < span.closest )
+	span.closest = sample.distance;
+    }
 
-  float closest = 1000;
+    sample.oid = oid;
+    lastSample = &sample;
+  }
 
-  for ( int count = numSamples-1; count > 0; --count )
+  if ( sampleSpans.size() > 0 )
   {
-    int angIndex = LidarDevice::addAngIndex( count, indexOffset );
-      
-    LidarSample &sample( samples[angIndex] );
+    LidarSampleSpan &first( sampleSpans.front() );
 
-    if ( sample.oid != 0 )
+    if ( sampleSpans.size() > 1 )
     {
-      if ( higherAngIndex == -1 )
-      {	higherAngIndex = angIndex;
-	lowerAngIndex  = angIndex;
-	closest = sample.distance;
-      }
-      else if ( samples[lowerAngIndex].oid == sample.oid )
-      {
-	lowerAngIndex = angIndex;
-	float c = sample.distance;
-	if ( c < closest )
-	  closest = c;
+      const LidarSampleSpan &last( sampleSpans.back() );
+
+      if ( samples[first.lowerIndex].coord.distance( lastSample->coord ) <= objectMaxDistance )
+      { 	// rotate the start of the first span back to the last one
+	first.lowerIndex   = last.lowerIndex;
+	first.higherIndex += numSamples;
+	if ( last.closest < first.closest )
+	  first.closest = last.closest;
       }
       else
-      {
-	float extent = samples[lowerAngIndex].coord.distance( samples[higherAngIndex].coord );
-	  
-//	printf( "extent1: %d - %d  %g\n", lowerAngIndex, higherAngIndex, extent );
-
-	if ( extent >= objectMinExtent )
-	  addDetectedObject( detectedObjects, lowerAngIndex, higherAngIndex, extent, closest );
-	
-	higherAngIndex = angIndex;
-	lowerAngIndex  = angIndex;
-	closest = 1000;
-      }
+	addDetectedObject( detectedObjects, last );
     }
-  }
 
-  if ( higherAngIndex != -1 && lowerAngIndex != -1 && lowerAngIndex != higherAngIndex )
-  {
-    float extent = samples[lowerAngIndex].coord.distance( samples[higherAngIndex].coord );
-//    printf( "extent2: %d - %d  %g\n", lowerAngIndex, higherAngIndex, extent );
-    if ( extent >= objectMinExtent )
-      addDetectedObject( detectedObjects, lowerAngIndex, higherAngIndex, extent, closest );
+    addDetectedObject( detectedObjects, first );
   }
 
-  for ( int angIndex = numSamples-1; angIndex > 0; --angIndex )
-    samples[angIndex].oid = 0;
-
-  detectedObjects.calcCurvature( samples );
+  objectFeatures.extract( detectedObjects, samples );
 
   if ( !doObjectTracking || detectedObjects.size() == 0 || objects.size() == 0 )
   {
@@ -5053,55 +5659,44 @@ LidarDevice::detectObjects()
   }
   else
   {
-    std::vector<TrackInfo> trackInfo;
-    
-	/* calculate distances from substage to merged stage */
+    TrackAssignment &assignment( objectAssignment );
+    assignment.clear( detectedObjects.size(), objects.size() );
+
+	/* calculate distances from detected to last objects */
 
     for ( int di = 0; di < detectedObjects.size(); ++di )
     { for ( int oi = 0; oi < objects.size(); ++oi )
       { double distance =  detectedObjects[di].center.distance( objects[oi].center );
 	if ( distance <= objectTrackDistance )
-	  trackInfo.push_back( TrackInfo({distance, di, oi}) ); /* { distance, detectedIndex, objectIndex } */
+	  assignment.add( di, oi, distance );
       }
     }
 
-    std::sort( trackInfo.begin(), trackInfo.end(), compareTrackInfo );
-
-    bool detectedUsed[detectedObjects.size()] = { false };
-    bool objectsUsed[objects.size()] 	      = { false };
-    std::fill_n( detectedUsed, detectedObjects.size(), 	false );
-    std::fill_n( objectsUsed,  objects.size(), 	 	false );
-
-    for ( int i = 0; i < trackInfo.size(); ++i )
-    {
-      TrackInfo &ti( trackInfo[i] );
+    assignment.solve( objectTrackDistance, objectOptimalAssignment );
 
-	  /* only if they are not already assigned */
-      if ( !detectedUsed[ti.detectedIndex] && !objectsUsed[ti.objectIndex] )
-      {
-	detectedObjects[ti.detectedIndex].oid = objects[ti.objectIndex].oid;
-
-	detectedUsed[ti.detectedIndex] = true;
-	objectsUsed[ti.objectIndex]    = true;
-      }
-    }
-	/* add iods for objects with no correspondence */
     for ( int di = ((int)detectedObjects.size())-1; di >= 0; --di )
-      if ( !detectedUsed[di] )
+    {
+      if ( assignment.rowMatch[di] >= 0 )
+	detectedObjects[di].oid = objects[assignment.rowMatch[di]].oid;
+      else	/* add iods for objects with no correspondence */
 	detectedObjects[di].oid = (oidCount=(oidCount%1024)+1);
+    }
 
     objects = detectedObjects;
   }
 
+      // only the spans carry segment ids, replace them by the object ids
+
+  for ( int si = ((int)sampleSpans.size())-1; si >= 0; --si )
+    for ( int index = sampleSpans[si].lowerIndex; index <= sampleSpans[si].higherIndex; ++index )
+      samples[angIndex(index)].oid = 0;
+
   for ( int oi = 0; oi < objects.size(); ++oi )
   {
-    int lowerAngIndex  = addAngIndex( objects[oi].lowerIndex, 0 );
-    int higherAngIndex = addAngIndex( objects[oi].higherIndex, 0 );
-    
     int oid = objects[oi].oid;
 
-    for ( int angIndex = lowerAngIndex; angIndex <= higherAngIndex; ++angIndex )
-      samples[angIndex].oid = oid;
+    for ( int index = objects[oi].lowerIndex; index <= objects[oi].higherIndex; ++index )
+      samples[angIndex(index)].oid = oid;
 
 //    printf( "%d: %g\n", objects[oi].oid, objects[oi].lineScatter(samples) );
   }
@@ -5181,7 +5776,7 @@ LidarDevice::scanSimulation( LidarRawSampleBuffer &sampleBuffer, bool coverage )
 bool
 LidarDevice::scanLDLidar( LidarRawSampleBuffer &sampleBuffer )
 {
-  ScanData laserScan;
+  ScanData &laserScan( scanPoints );
   bool result = false;
 
   if ( ldSerialDrv == NULL )
@@ -5217,7 +5812,7 @@ LidarDevice::scanLDLidar( LidarRawSampleBuffer &sampleBuffer )
 bool
 LidarDevice::scanMSLidar( LidarRawSampleBuffer &sampleBuffer )
 {
-  ScanData laserScan;
+  ScanData &laserScan( scanPoints );
   bool result = false;
 
   if ( msSerialDrv == NULL )
@@ -5253,7 +5848,7 @@ LidarDevice::scanMSLidar( LidarRawSampleBuffer &sampleBuffer )
 bool
 LidarDevice::scanLSLidar( LidarRawSampleBuffer &sampleBuffer )
 {
-  ScanData laserScan;
+  ScanData &laserScan( scanPoints );
   bool result = false;
 
   if ( lsSerialDrv == NULL || !lsSerialDrv->grabScanData( laserScan ) )
@@ -5287,7 +5882,7 @@ LidarDevice::scanLSLidar( LidarRawSampleBuffer &sampleBuffer )
 bool
 LidarDevice::scanYDLidar( LidarRawSampleBuffer &sampleBuffer )
 {
-  ScanData laserScan;
+  ScanData &laserScan( scanPoints );
   bool result = false;
 
   if ( ydSerialDrv == NULL || !ydSerialDrv->grabScanData( laserScan ) )
@@ -5391,12 +5986,94 @@ LidarDevice::scan()
 {
   if ( !isReady() )
     return false;
-  LidarRawSampleBuffer nodes;
+
+  LidarScanFrame &frame( scanFrames[scanFrameIndex] );
+
+  receiveScan( frame );
+  processScan( frame );
+
+  return frame.result;
+}
+
+	/* receive on the device thread, process on the compute pool while the next scan is read */
+bool
+LidarDevice::scanAsync()
+{
+  if ( !isReady() )
+    return false;
+
+  LidarScanFrame &frame( scanFrames[scanFrameIndex] );
+
+  receiveScan( frame );
+
+  if ( !frame.result && !frame.clearData )
+  { if ( isEnvScanning )
+    { waitScanProcessed();
+      continueEnvScan( false );
+    }
+    return false;
+  }
+
+  waitScanProcessed();
+
+  { std::lock_guard<std::mutex> guard( scanMutex );
+    scanProcessing = true;
+  }
+  scanFrameIndex = 1 - scanFrameIndex;
+
+  submitScanStage( frame, 0 );
+
+  return frame.result;
+}
+
+static WorkStealingPool &
+computePool()
+{
+  static WorkStealingPool *pool = new WorkStealingPool( g_ComputeThreads );
+  return *pool;
+}
+
+	/* queue one stage of the frame, each stage queues the next one when done */
+void
+LidarDevice::submitScanStage( LidarScanFrame &frame, int stage )
+{
+  computePool().submit( [this,&frame,stage]()
+  {
+    processScanStage( frame, stage );
+
+    if ( stage+1 < NumScanStages )
+    { submitScanStage( frame, stage+1 );
+      return;
+    }
+    
+    if ( isEnvScanning )
+      continueEnvScan( frame.result );
+
+    { std::lock_guard<std::mutex> guard( scanMutex );
+      scanProcessing = false;
+    }
+    scanCond.notify_all();
+  }, computeSlot );
+}
+
+void
+LidarDevice::waitScanProcessed()
+{
+  std::unique_lock<std::mutex> lock( scanMutex );
+  scanCond.wait( lock, [this] { return !scanProcessing; } );
+}
+
+void
+LidarDevice::receiveScan( LidarScanFrame &frame )
+{
+  LidarRawSampleBuffer &nodes( frame.nodes );
+  nodes.resize( 0 );
   bool result    = false;
   bool clearData = false;
   bool isEnvData = false;
 
   uint64_t samplesTimeStamp = 0;
+  uint64_t arrivalTime      = 0;
 
   if ( inFile != NULL )
   { 
@@ -5423,12 +6100,17 @@ LidarDevice::scan()
       else
       { usleep( 100*1000 );
 	if ( inFile->is_eof() )
+        { lock();
 	  errorMsg = "end of file";
+	  unlock();
+	}
       }
     }
   }
   else if ( inDrv != NULL )
   { result = inDrv->grabScanData( nodes, 1, true );
+    if ( result )
+      arrivalTime = inDrv->scanDataList.arrivalTime;
     
 //    printf( "grabScanData: %d\n", result );
     
@@ -5451,6 +6133,12 @@ LidarDevice::scan()
 //  printf( "result: %d %ld\n", result, nodes.size() );
   uint64_t now = getmsec();
 
+	// the blocking drivers return as soon as the scan data arrived
+  if ( result && arrivalTime == 0 )
+    arrivalTime = LatencyTracer::usec();
+
+  frame.receiveTime = (result ? arrivalTime : 0);
+
   if ( samplesTimeStamp == 0 )
     samplesTimeStamp = now;
 
@@ -5458,7 +6146,9 @@ LidarDevice::scan()
   {
     if ( !g_FileDriverPaused )
     {
+      lock();			// receivedTime is written by processScan() on the compute pool
       uint64_t no_data_msec = now - receivedTime;
+      unlock();
 
 #define DEBUG_FRAMERATE 0
 
@@ -5503,172 +6193,309 @@ LidarDevice::scan()
       }
     }
 
+    lock();
     errorMsg = "";
+    unlock();
   }
-  
-  if ( result || clearData )
+
+  frame.result		 = result;
+  frame.clearData	 = clearData;
+  frame.isEnvData	 = isEnvData;
+  frame.now		 = now;
+  frame.samplesTimeStamp = samplesTimeStamp;
+
+  if ( result )
+    LatencyTracer::addSince( LatencyTracer::Receive, arrivalTime );
+}
+
+	/* the stages of processScan() run in sequence for one frame, on the compute
+	   pool each stage is queued as its own task when the previous one finished */
+void
+LidarDevice::processScan( LidarScanFrame &frame )
+{
+  if ( !frame.result && !frame.clearData )
+    return;
+
+  for ( int stage = 0; stage < NumScanStages; ++stage )
+    processScanStage( frame, stage );
+}
+
+void
+LidarDevice::processScanStage( LidarScanFrame &frame, int stage )
+{
+  switch ( stage )
   {
-    lock();
-    if ( result )
-    { timeStamp    = now - startTime;
-      receivedTime = now;
-    }
-    
-    info.samplesPerScan = nodes.size();
-    info.tick();
-    
-    if ( g_Verbose >= 2 )
-      Lidar::info( "samples: %d \tfps: %d\t average fps: %d\t average samples: %d", info.samplesPerScan, info.fps.fps, info.average_fps.fps, info.average_samples.average() );
-    
-    sampleBufferIndex = (sampleBufferIndex+1) % (32768*numSampleBuffers);
+    case ConvertStage:
+      convertScan( frame );
+      break;
+    case AccumulateStage:
+      if ( isAccumulating )
+	accumulateScan();
+      break;
+    case DetectStage:
+      detectScan( frame );
+      break;
+    case AdaptEnvStage:
+      adaptScanEnv( frame );
+      break;
+  }
+}
 
-    LidarSampleBuffer &samples( sampleBuffer(0) );
+void
+LidarDevice::convertScan( LidarScanFrame &frame )
+{
+  LidarRawSampleBuffer &nodes( frame.nodes );
+
+  const bool     result           = frame.result;
+  const bool     isEnvData        = frame.isEnvData;
+  const uint64_t now              = frame.now;
+
+  if ( result )
+    scanReceiveTime = frame.receiveTime;
+
+  lock();
+  if ( result )
+  { timeStamp    = now - startTime;
+    receivedTime = now;
+  }
+  
+  info.samplesPerScan = nodes.size();
+  info.tick();
+  
+  if ( g_Verbose >= 2 )
+    Lidar::info( "samples: %d \tfps: %d\t average fps: %d\t average samples: %d", info.samplesPerScan, info.fps.fps, info.average_fps.fps, info.average_samples.average() );
+  
+  sampleBufferIndex = (sampleBufferIndex+1) % (32768*numSampleBuffers);
+
+  LidarSampleBuffer &samples( sampleBuffer(0) );
 /*
-    printf( "++++++++++\n" );
+  printf( "++++++++++\n" );
 */  
-  
-    for (int i = (int)numSamples-1; i >= 0; --i)
-    { LidarSample &sample( samples[i] );
-      sample.quality       = -1;
-      sample.oid           = 0;
-      sample.touched       = false;
-    }
+
+  for (int i = (int)numSamples-1; i >= 0; --i)
+  { LidarSample &sample( samples[i] );
+    sample.quality       = -1;
+    sample.oid           = 0;
+    sample.touched       = false;
+  }
+  std::fill( scanQuality.begin(), scanQuality.end(), -1.0f );
 
 //    printf( "1 char; %g %g\n", char1, char2 );
 
-    for (int i = (int)(nodes.size())-1; i >= 0; --i)
-    {
-      int quality     = nodes[i].quality;
-      samples[i].sourceQuality = quality;
+  scanColumns.convert( nodes, char1, char2, binDirections, numSamples );
 
-      float angle     = M_PI * (nodes[i].angle_z_q14 * 90.f / (1 << 14)) / 180.0;
-      float distance  = nodes[i].dist_mm_q2/1000.0f/4.0f;
-      int angIndex    = angIndexByAngle( angle );
+  const LidarSampleColumns &columns( scanColumns );
 
-      LidarSample &sample( samples[angIndex] );
-      sample.sourceIndex  = i;
-      sample.touched      = true;
-  
-      //      if ( quality > info.spec.minQuality )
-      {
-//	if ( sample.quality != 0 || distance < sample.distance )
-	{
-	  sample.quality    = quality;
-	  sample.angle      = angle;
-	  sample.distance   = nodes[i].dist_mm_q2/1000.0f/4.0f;
-//        visited[angIndex] = true;
-      
-//        printf( "%d %d\n", i, angIndexByAngle(sample.angle) );
+  sampleHistory.push( columns, info.spec.minQuality );
 
-//    printf( "2 char; %g %g\n", char1, char2 );
+  for (int i = columns.size-1; i >= 0; --i)
+  {
+    samples[i].sourceQuality = columns.quality[i];
 
-	  sample.distance = sample.distance * (char1 + char2 * sample.distance);
-	
-	  Vector3D coord( sample.distance * sin( sample.angle ), sample.distance * cos( sample.angle ), 0.0 );
-	  sample.coord = matrix * coord;
-	}
-      }
-    }
+    LidarSample &sample( samples[columns.angIndex[i]] );
+    sample.sourceIndex  = i;
+    sample.touched      = true;
+    sample.quality      = columns.quality[i];
+    sample.angle        = columns.angle[i];
+    sample.distance     = columns.distance[i];
+    sample.coord        = Vector3D( columns.x[i], columns.y[i], 0.0 );
 
-    if ( outDrv != NULL && !isEnvData )
-    {
-      int ni = 0;
-      nodes.resize( 0 );
+    scanDistance[columns.angIndex[i]] = columns.distance[i];
+    scanQuality [columns.angIndex[i]] = columns.quality[i];
+  }
 
-      for ( int i = (int)numSamples-1; i >= 0; --i )
-      { 
-	if ( (!(envValid && useOutEnv) && samples[i].quality > info.spec.minQuality) || isValid( i ) )
-	{ LidarSample &sample( samples[i] );
-	  nodes.resize( ni+1 );
-	  nodes[ni].quality     = sample.quality;
-	  nodes[ni].dist_mm_q2  = sample.distance * 1000 * 4;
-	  nodes[ni].angle_z_q14 = sample.angle / M_PI * 180.0 / 90.0 * (1 << 14);
-	  ni += 1;
-	}
+  classifyScan();
+
+  if ( outDrv != NULL && !isEnvData )
+  {
+    int ni = 0;
+    nodes.resize( 0 );
+
+    for ( int i = (int)numSamples-1; i >= 0; --i )
+    { 
+      if ( (!(envValid && useOutEnv) && samples[i].quality > info.spec.minQuality) || isValid( i ) )
+      { LidarSample &sample( samples[i] );
+	nodes.resize( ni+1 );
+	nodes[ni].quality     = sample.quality;
+	nodes[ni].dist_mm_q2  = sample.distance * 1000 * 4;
+	nodes[ni].angle_z_q14 = sample.angle / M_PI * 180.0 / 90.0 * (1 << 14);
+	ni += 1;
       }
-      outDrv->sendScanData( nodes );
     }
-    
-    if ( isAccumulating )
-    {
-      for (int i = numSamples-1; i >= 0; --i)
-      {
-	if ( scanValid(i) )
-	{ 
-	  LidarSample &sample     ( samples[i]      );
-	  LidarSample &accumSample( accumSamples[i] );
+    outDrv->sendScanData( nodes );
+  }
+  unlock();
+}
+
+void
+LidarDevice::accumulateScan()
+{
+  lock();
+
+  LidarSampleBuffer &samples( sampleBuffer(0) );
+
+  for (int i = numSamples-1; i >= 0; --i)
+  {
+    if ( scanValid(i) )
+    { 
+      LidarSample &sample     ( samples[i]      );
+      LidarSample &accumSample( accumSamples[i] );
 
 //	  printf( "acc: %d %d\n", i, sample.quality );
 
-	  double alpha = 1.0 / accumSample.accumCount;
+      double alpha = 1.0 / accumSample.accumCount;
 
-	  accumSample.angle       = sample.angle;
-	  accumSample.distance    = sample.distance;
-	  accumSample.quality     = sample.quality;
-	  accumSample.oid         = 0;
-	  accumSample.accumCount += 1;
+      accumSample.angle       = sample.angle;
+      accumSample.distance    = sample.distance;
+      accumSample.quality     = sample.quality;
+      accumSample.oid         = 0;
+      accumSample.accumCount += 1;
 
-	  if ( accumSample.accumCount > maxAccumCount )
-	    maxAccumCount = accumSample.accumCount;
+      if ( accumSample.accumCount > maxAccumCount )
+	maxAccumCount = accumSample.accumCount;
 
-	  Vector3D coord( accumSample.distance * sin( accumSample.angle ), accumSample.distance * cos( accumSample.angle ), 0.0 );
-	  coord = matrix * coord;
+      Vector3D coord( binDirections.coord( i, accumSample.distance ) );
 
 //	  printf( "alpha: %g\n", alpha );
-	  
-	  accumSample.coord = coord * alpha + accumSample.coord * (1-alpha);
-	}
-      }
+      
+      accumSample.coord = coord * alpha + accumSample.coord * (1-alpha);
     }
+  }
 
-    if ( isEnvData )
-    {
-      unlock();
+  unlock();
+}
 
-      scanEnv();
-      updateEnv();
-      processEnv();
-      
-      setUseOutEnv( useOutEnvBak );
+void
+LidarDevice::detectScan( LidarScanFrame &frame )
+{
+  LidarRawSampleBuffer &nodes( frame.nodes );
 
-      isEnvScanning = false;
+  const bool     result           = frame.result;
+  const bool     isEnvData        = frame.isEnvData;
+  const uint64_t samplesTimeStamp = frame.samplesTimeStamp;
 
-      envValid = (nodes.size() > 0);  
-    }
-    else
-    {
-      if ( !dataValid )
-	dataValid = true;
+  lock();
 
-      if ( doObjectDetection )
-      {
-	if ( isEnvScanning )
-	  objects = LidarObjects();
-	else
-        {
-	  detectObjects();
-	  objects.setTimeStamp( samplesTimeStamp );
-	}
-      }
+  if ( result )
+    LatencyTracer::addSince( LatencyTracer::Scan, scanReceiveTime );
 
-      unlock();
-    }
+  if ( isEnvData )
+  {
+    unlock();
+
+    scanEnv();
+    updateEnv();
+    processEnv();
+    
+    setUseOutEnv( useOutEnvBak );
+
+    isEnvScanning = false;
+
+    envValid = (nodes.size() > 0);  
+  }
+  else
+  {
+    if ( !dataValid )
+      dataValid = true;
 
-    if ( dataValid && !isEnvScanning && doEnvAdaption && envAdaptSec > 0.0 )
+    if ( doObjectDetection )
     {
-      adaptEnv();
-  
-      processEnv();
+      if ( isEnvScanning )
+	objects = LidarObjects();
+      else
+      { LatencyTracer::Scope scope( LatencyTracer::Detect );
+	detectObjects();
+	objects.setTimeStamp( samplesTimeStamp );
+      }
+    }
+
+    publishObjects( !isEnvScanning, samplesTimeStamp );
+
+    unlock();
+  }
+}
+
+void
+LidarDevice::adaptScanEnv( LidarScanFrame &frame )
+{
+  const uint64_t now = frame.now;
+
+  if ( dataValid && !isEnvScanning && envMixture.enabled )
+  {
+    const float alpha = envMixture.alpha( now );
+
+    for ( int i = numSamples-1; i >= 0; --i )
+      if ( scanQuality[i] > info.spec.minQuality )
+	envMixture.update( i, scanDistance[i], alpha, envThreshold );
+  }
+  else if ( dataValid && !isEnvScanning && doEnvAdaption && envAdaptSec > 0.0 )
+  {
+    adaptEnv();
+
+    if ( envDirtyBins.size() > 0 || !envFilterValid )
+    { processEnv( true );
       envChanged();
+    }
+
+    envValid = true;
+  }
+}
+
+void
+LidarDevice::continueEnvScan( bool result )
+{
+  uint64_t currentTime = getmsec();
+  uint64_t milliSec    = currentTime - processStartTime;
 
-      envValid = true;
+  if ( milliSec < envScanSec * 1000 )
+  { if ( result )
+    { lock();
+      updateEnv();
+      unlock();
     }
+  }
+  else
+  { 
+    processEnv();
+    envChanged();
 
-//    uint64_t end = getmsec();
-//    printf( "scan: %ld\n", end - now );
+    setUseOutEnv( useOutEnvBak );
+
+    isEnvScanning = false;
   }
+}
 
-  return result;
+void
+LidarDevice::publishObjects( bool valid, uint64_t timestamp )
+{
+  LidarObjectsFrame &frame( objectsFrame.writeBuffer() );
+
+  frame.valid       = valid;
+  frame.timeStamp   = timestamp;
+  frame.receiveTime = scanReceiveTime;
+  frame.origin      = matrix.w;
+
+  if ( valid )
+    frame.objects = objects;
+  else
+    frame.objects.clear();
+
+  objectsFrame.publish();
+
+  objectsFrameValid = valid;
+
+  framesActive.store( valid );
+  publishedFrames.fetch_add( 1 );
+
+  frameSignal.notify();
+}
+
+const LidarObjectsFrame &
+LidarDevice::latestObjects()
+{
+  objectsFrame.update();
+
+  return objectsFrame.readBuffer();
 }
 
 LidarObjects
@@ -5759,6 +6586,18 @@ LidarDevice::parseArg( int &i, const char *argv[], int &argc )
   {
     envFilterSize = atof( argv[++i] );
   }
+  else if ( strcmp(argv[i],"lidar.env.mixture") == 0 )
+  {
+    envMixture.enabled = atoi( argv[++i] );
+  }
+  else if ( strcmp(argv[i],"lidar.env.mixtureSec") == 0 )
+  {
+    envMixture.learnSec = atof( argv[++i] );
+  }
+  else if ( strcmp(argv[i],"lidar.env.mixtureWeight") == 0 )
+  {
+    envMixture.minWeight = atof( argv[++i] );
+  }
   else if ( strcmp(argv[i],"lidar.object.maxDistance") == 0 )
   {
     objectMaxDistance = atof( argv[++i] );
@@ -5775,6 +6614,18 @@ LidarDevice::parseArg( int &i, const char *argv[], int &argc )
   {
     objectTrackDistance = atof( argv[++i] );
   }
+  else if ( strcmp(argv[i],"lidar.object.optimalAssignment") == 0 )
+  {
+    objectOptimalAssignment = atoi( argv[++i] );
+  }
+  else if ( strcmp(argv[i],"lidar.denoise.depth") == 0 )
+  {
+    sampleHistory.setDepth( atoi( argv[++i] ), sampleHistory.minCount );
+  }
+  else if ( strcmp(argv[i],"lidar.denoise.minCount") == 0 )
+  {
+    sampleHistory.setDepth( sampleHistory.depth, atoi( argv[++i] ) );
+  }
   else
     success = false;
     
@@ -5788,12 +6639,17 @@ LidarDevice::copyArgs( LidarDevice *argDevice )
   objectMinExtent 	= argDevice->objectMinExtent;
   objectMaxExtent 	= argDevice->objectMaxExtent;
   objectTrackDistance 	= argDevice->objectTrackDistance;
+  objectOptimalAssignment = argDevice->objectOptimalAssignment;
   envThreshold 		= argDevice->envThreshold;
   envFilterMinDistance 	= argDevice->envFilterMinDistance;
   envScanSec 		= argDevice->envScanSec;
   envAdaptSec 		= argDevice->envAdaptSec;
   envFilterSize 	= argDevice->envFilterSize;
   doEnvAdaption         = argDevice->doEnvAdaption;
+  envMixture.enabled	= argDevice->envMixture.enabled;
+  envMixture.learnSec	= argDevice->envMixture.learnSec;
+  envMixture.minWeight	= argDevice->envMixture.minWeight;
+  sampleHistory.setDepth( argDevice->sampleHistory.depth, argDevice->sampleHistory.minCount );
 }
 
 
@@ -5822,12 +6678,18 @@ LidarDevice::printArgHelp() const
   printArgHelpImpl( "lidar.object.minExtent",		objectMinExtent,	"min extent of a group of samples to be reported as a object" );
   printArgHelpImpl( "lidar.object.maxExtent",		objectMaxExtent,	"\textent of a group of samples to be split into several objects" );
 //  printArgHelpImpl( "lidar.object.trackDistance", 	objectTrackDistance,	"\tmax distance between samples to be united to a singe object" );
+  printArgHelpImpl( "lidar.object.optimalAssignment",	objectOptimalAssignment,"keep object ids by optimal=1 or greedy=0 assignment to the last frame" );
   printArgHelpImpl( "lidar.env.threshold",		envThreshold,		"\tdistance from measured value in which a sample is still reported as environmental" );
   printArgHelpImpl( "lidar.env.filterMinDistance",	envFilterMinDistance,	"distance between samples used for eroding and smoothing the environment" );
   printArgHelpImpl( "lidar.env.scanSec",		envScanSec,		"\ttime in sec used to scan the environment" );
   printArgHelpImpl( "lidar.env.adapt",		doEnvAdaption,		"\tswitches Environment adaption on=1 or off=0" );
   printArgHelpImpl( "lidar.env.adaptSec",		envAdaptSec,		"\ttime in sec used to adapt the environment." );
   printArgHelpImpl( "lidar.env.filterSize",		envFilterSize,		"size of angular filter used for eroding and smoothing the environment" );
+  printArgHelpImpl( "lidar.env.mixture",		envMixture.enabled,	"\tlearns several distance modes per angle on=1 instead of adapting a single environment off=0" );
+  printArgHelpImpl( "lidar.env.mixtureSec",		envMixture.learnSec,	"\ttime in sec a new distance mode takes to reach full weight" );
+  printArgHelpImpl( "lidar.env.mixtureWeight",	envMixture.minWeight,	"min weight of a distance mode to be treated as environment" );
+  printArgHelpImpl( "lidar.denoise.depth",		sampleHistory.depth,	"\tnumber of frames including the current one checked for sample dropouts (2..32)" );
+  printArgHelpImpl( "lidar.denoise.minCount",		sampleHistory.minCount,	"number of dropouts within lidar.denoise.depth frames to treat a sample as noise" );
 }
   
 
@@ -5835,12 +6697,19 @@ LidarDevice::printArgHelp() const
 void
 LidarDevice::ThreadFunction()
 {
+  const int minIdleUSec = 500;
+  const int maxIdleUSec = 4000;
+
+  int idleUSec = minIdleUSec;
+
   while( !exitThread )
   { 
     bool open = isOpen();
     
     if ( open != shouldOpen && !openFailed )
     {
+      waitScanProcessed();
+
       if ( shouldOpen )
 	openDevice();
       else
@@ -5851,6 +6720,11 @@ LidarDevice::ThreadFunction()
 
     if ( !open )
     {
+      waitScanProcessed();
+
+      if ( objectsFrameValid )
+	publishObjects( false );
+
       usleep( 100 * 1000 );
       
       if ( outDrv != NULL )
@@ -5866,13 +6740,21 @@ LidarDevice::ThreadFunction()
       if ( inDrv != NULL )
       {
 	if ( envOutDirty )
+	{ waitScanProcessed();		// the env stage writes envSamples
 	  sendOutEnv();
+	}
 
 	inDrv->update( waitTimeout );
 
 	std::string cmd;
+	bool scanProcessed = false;
 	while ( !(cmd=inDrv->getNextCmd()).empty() )
         {
+	  if ( !scanProcessed )		// commands change spec and env used by the scan stages
+	  { waitScanProcessed();
+	    scanProcessed = true;
+	  }
+
 	  if ( cmd == "connect" )
 	    envChanged();
 	  else if ( cmd == "startPowerUp" )
@@ -5911,8 +6793,14 @@ LidarDevice::ThreadFunction()
 	outDrv->update( 0 );	
 
 	std::string cmd;
+	bool scanProcessed = false;
 	while ( !(cmd=outDrv->getNextCmd()).empty() )
         {
+	  if ( !scanProcessed )
+	  { waitScanProcessed();
+	    scanProcessed = true;
+	  }
+
 	  if ( cmd == "motorOn" )
 	    setMotorState( true );
 	  else if ( cmd == "motorOff" )
@@ -5958,32 +6846,24 @@ LidarDevice::ThreadFunction()
 	  }
 	}
 
-	bool result = scan();
-
-        if ( isEnvScanning )
-        { 
-	  uint64_t currentTime = getmsec();
-	  uint64_t milliSec    = currentTime - processStartTime;
+	bool result;
 
-	  if ( milliSec < envScanSec * 1000 )
-	  { if ( result )
-            { lock();
-	      updateEnv();
-	      unlock();
-	    }
-	  }
-	  else
-	  { 
-	    processEnv();
-	    envChanged();
-
-	    setUseOutEnv( useOutEnvBak );
+	if ( g_ComputeThreads > 0 )
+	  result = scanAsync();
+	else
+        { result = scan();
+	  if ( isEnvScanning )
+	    continueEnvScan( result );
+	}
 
-	    isEnvScanning = false;
-	  }
+	if ( !result && !isEnvScanning )
+        { usleep( idleUSec );
+	  if ( idleUSec < maxIdleUSec )
+	    idleUSec *= 2;
 	}
-	else if ( !result )
-	  usleep( 500 );
+
+	if ( result )
+	  idleUSec = minIdleUSec;
       }
     }
     else
@@ -5991,6 +6871,8 @@ LidarDevice::ThreadFunction()
       usleep( 10*1000 );
     }
   }
+
+  waitScanProcessed();
 }
 
 
@@ -6487,6 +7369,35 @@ LidarDevices::update()
   }
 }
 
+bool
+LidarDevices::waitForFrames( uint64_t timeoutUSec )
+{
+  auto allReported = [this]() -> bool
+  {
+    int numActive = 0;
+
+    for ( int d = 0; d < size(); ++d )
+    {
+      LidarDevice *device = (*this)[d];
+      if ( !device->framesActive.load() )
+	continue;
+
+      numActive += 1;
+      if ( device->publishedFrames.load() == device->consumedFrames )
+	return false;
+    }
+
+    return numActive > 0;
+  };
+
+  bool complete = LidarDevice::frameSignal.wait( allReported, timeoutUSec );
+
+  for ( int d = 0; d < size(); ++d )
+    (*this)[d]->consumedFrames = (*this)[d]->publishedFrames.load();
+
+  return complete;
+}
+
 bool
 LidarDevices::parseArg( int &i, const char *argv[], int &argc ) 
 {
@@ -6508,6 +7419,22 @@ LidarDevices::parseArg( int &i, const char *argv[], int &argc )
   {
     envScanSec = atof( argv[++i] );
   }
+  else if ( strcmp(argv[i],"lidar.virtual.recvBatch") == 0 )
+  {
+    LidarVirtualDriver::recvBatchSize = atoi( argv[++i] );
+  }
+  else if ( strcmp(argv[i],"lidar.virtual.recvBufferSize") == 0 )
+  {
+    LidarVirtualDriver::recvBufferSize = atoi( argv[++i] );
+  }
+  else if ( strcmp(argv[i],"lidar.virtual.compact") == 0 )
+  {
+    LidarVirtualDriver::compactFormat = atoi( argv[++i] );
+  }
+  else if ( strcmp(argv[i],"lidar.computeThreads") == 0 )
+  {
+    g_ComputeThreads = atoi( argv[++i] );
+  }
   else
     success = false;
     
@@ -6521,6 +7448,10 @@ LidarDevices::printArgHelp() const
   printArgHelpImpl( "lidar.register.sec",    registerSec,     "\ttime in sec used to register markers" );
   printArgHelpImpl( "lidar.register.maxObjectDistanceOfMarkers",    LidarObject::maxMarkerDistance,     "\tmaximum distance between two flat objects to be treated as marker" );
   printArgHelpImpl( "lidar.register.markerMatchDifference", markerMatchDifference,     "\tmaximum difference between markers to treat them as the same marker" );
+  printArgHelpImpl( "lidar.virtual.recvBatch",  LidarVirtualDriver::recvBatchSize,  "\tmax number of UDP packets of virtual devices received per system call, 1 receives them one by one" );
+  printArgHelpImpl( "lidar.virtual.recvBufferSize", LidarVirtualDriver::recvBufferSize, "kernel receive buffer size in bytes of virtual device sockets, 0 uses the system default" );
+  printArgHelpImpl( "lidar.virtual.compact",	LidarVirtualDriver::compactFormat,  "\tswitches the compact scan data format for virtual devices on=1 or off=0, old peers always use the raw format" );
+  printArgHelpImpl( "lidar.computeThreads",	g_ComputeThreads,  "\tthreads sharing detection and env adaption of all devices, 0 processes each scan in its device thread" );
 }
 
 void
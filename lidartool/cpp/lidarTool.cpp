@@ -91,6 +91,7 @@ static bool  				g_UseCheckPoints = false;
 static bool  				g_ExpertMode     = false;
 
 static double				g_MaxFps = 60.0;
+static double				g_FrameSyncMSec = 0.0;
 static int				g_Verbose = 0;
 static std::string 			g_ID( "Default" );
 static KeyValueMap 			g_UsedGroups;
@@ -887,6 +888,8 @@ createSimulationEnvMap( LidarDevice &device )
   
   for ( int angIndex = LidarDevice::numSamples-1; angIndex >= 0; --angIndex )
     device.envSamples[angIndex] = envRawSamples[angIndex];
+  device.updateEnvDistance();
+  device.envFilterValid = false;	// eroded and smoothed windows belong to the previous env
   
   //  device.updateEnv();
   device.unlock();
@@ -4095,6 +4098,64 @@ public:
     }
 };
 
+class latency_resource : public http_resource {
+public:
+    render_const std::shared_ptr<http_response> render_GET(const http_request& req) {
+
+      LatencyTracer &tracer( LatencyTracer::global() );
+
+      std::string json( tracer.json() );
+
+      webMutex.lock();
+
+      if ( g_Track.m_Stage != NULL && g_Track.m_Stage->observer != NULL )
+      {	  // append the queue state of the threaded observers
+	TrackableMultiObserver &multi( *g_Track.m_Stage->observer );
+
+	json.pop_back();
+	json += ", \"observers\": {";
+
+	for ( int i = 0; i < multi.observer.size(); ++i )
+        { TrackableObserver &observer( *multi.observer[i] );
+	  if ( i > 0 )
+	    json += ",";
+	  json += " \"" + observer.name + "\": { \"queueDepth\": " + std::to_string( observer.queueDepth() );
+	  json += ", \"queueDropped\": " + std::to_string( observer.queueDropped() ) + " }";
+	}
+
+	json += " } }";
+      }
+
+      std::string virt;
+      for ( int d = 0; d < g_Devices.size(); ++d )
+      { LidarDevice &device( *g_Devices[d] );
+	if ( device.inDrv == NULL )
+	  continue;
+	  // append the reassembly counters of the virtual input devices
+	LidarScanDataList &scans( device.inDrv->scanDataList );
+
+	virt += (virt.empty() ? " \"" : ", \"") + device.getNikName() + "\": { \"completed\": " + std::to_string( scans.numCompleted.load() );
+	virt += ", \"evicted\": " + std::to_string( scans.numEvicted.load() );
+	virt += ", \"stale\": " + std::to_string( scans.numStale.load() );
+	virt += ", \"late\": " + std::to_string( scans.numLate.load() );
+	virt += ", \"truncated\": " + std::to_string( device.inDrv->udpSocket.numTruncated.load() ) + " }";
+      }
+
+      if ( !virt.empty() )
+      { json.pop_back();
+	json += ", \"virtual\": {" + virt + " } }";
+      }
+
+      webMutex.unlock();
+
+      bool reset = false;
+      if ( getBoolArg( req, "reset", reset ) && reset )
+	tracer.reset();
+
+      return jsonResponse( json );
+    }
+};
+
 class get_resource : public http_resource {
 public:
     render_const std::shared_ptr<http_response> render(const http_request& req) {
@@ -5967,6 +6028,7 @@ static saveRegions_resource saveRegions_r;
 static saveBlueprint_resource saveBlueprint_r;
 static deviceList_resource deviceList_r;
 static status_resource status_r;
+static latency_resource latency_r;
 static get_resource get_r;
 static set_resource set_r;
 static clearMessage_resource clearMessage_r;
@@ -6017,6 +6079,7 @@ runWebServer()
 
   webserv->register_resource("/deviceList",  &deviceList_r);
   webserv->register_resource("/status",  &status_r);
+  webserv->register_resource("/latency",  &latency_r);
   webserv->register_resource("/get",  &get_r);
   webserv->register_resource("/set",  &set_r);
 
@@ -6317,6 +6380,7 @@ static void printGeneralHelp( int argc, const char *argv[], bool printAll=false
     printf( " -openOnStart\tdo not open devices on startup\n" );
   }
   printf( " +fps framesPerSec\tsets the maximum frame rate to process and track/report lidar data (default=%g)\n", g_MaxFps );
+  printf( " +frameSync msec\ttrack as soon as all devices delivered a new frame, but at the latest after msec (default=off)\n" );
   
 //  printf( "\n" );
 //  printf( " +powerOff\tswitches the devices power off and waits until it is killed. this prevents the A1 devices from restarting the motor\n" );
@@ -7680,6 +7744,14 @@ int main( int argc, const char *argv[] )
     { 
       g_Track.uniteMethod = LidarTrack::UniteObjects;
     }
+    else if ( strcmp(argv[i],"+motionSmooth") == 0 )
+    { 
+      g_Track.m_Stage->motionModel = pv::TrackableMultiStage<pv::BlobMarkerUnion>::MotionSmooth;
+    }
+    else if ( strcmp(argv[i],"+motionKalman") == 0 )
+    { 
+      g_Track.m_Stage->motionModel = pv::TrackableMultiStage<pv::BlobMarkerUnion>::MotionKalman;
+    }
     else if ( strcmp(argv[i],"+radialDisplacement") == 0 )
     { 
       LidarTrack::setRadialDisplacement( std::atof( argv[++i] ) );
@@ -7690,6 +7762,10 @@ int main( int argc, const char *argv[] )
     { 
       g_MaxFps = std::atof( argv[++i] );
     }
+    else if ( strcmp(argv[i],"+frameSync") == 0 )
+    { 
+      g_FrameSyncMSec = std::atof( argv[++i] );
+    }
     else if ( strcmp(argv[i],"+bluePrint") == 0 )
     {
       bluePrintFileName = argv[++i];
@@ -8061,7 +8137,21 @@ int main( int argc, const char *argv[] )
     uint64_t currentTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
     int64_t diff        = currentTime - startTime;
 
-    if ( diff < usecPerFrame-300 && usecPerFrame-diff-200 > 0 )
+    if ( g_FrameSyncMSec > 0.0 && !g_IsHUB )
+    {
+      int64_t deadline = g_FrameSyncMSec * 1000;
+
+      if ( diff < deadline )
+	g_Devices.waitForFrames( deadline-diff );
+
+      // usecPerFrame stays the minimum loop period, so devices at different rates do not drive tracking beyond +fps
+      currentTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+      diff        = currentTime - startTime;
+
+      if ( diff < usecPerFrame-300 && usecPerFrame-diff-200 > 0 )
+	usleep( usecPerFrame-diff-200 );
+    }
+    else if ( diff < usecPerFrame-300 && usecPerFrame-diff-200 > 0 )
       usleep( usecPerFrame-diff-200 );
 
 //    webMutex.lock();
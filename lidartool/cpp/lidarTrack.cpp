@@ -163,7 +163,7 @@ createTrackable( TrackableStage<BlobMarkerUnion> &stage, uint64_t timestamp, flo
 
 
 static void
-addObjectToStage( TrackableStage<BlobMarkerUnion> &stage, LidarObject &object, uint64_t timestamp )
+addObjectToStage( TrackableStage<BlobMarkerUnion> &stage, const LidarObject &object, uint64_t timestamp )
 {
   createTrackable( stage, timestamp, object.center.x, object.center.y, object.extent );
 }
@@ -171,18 +171,16 @@ addObjectToStage( TrackableStage<BlobMarkerUnion> &stage, LidarObject &object, u
 static void
 addToStage( LidarDevice *device, TrackableStage<BlobMarkerUnion> &stage, uint64_t timestamp )
 {
-  if ( !device->isOpen() || device->isEnvScanning || !device->dataValid )
+  const LidarObjectsFrame &frame( device->latestObjects() );
+
+  if ( !frame.valid )
     return;
   
-  device->lock();
-
-  for ( int oi = device->numDetectedObjects()-1; oi >= 0; --oi )
+  for ( int oi = ((int)frame.objects.size())-1; oi >= 0; --oi )
   { 
-    LidarObject &object( device->detectedObject( oi ) );
+    const LidarObject &object( frame.objects[oi] );
     addObjectToStage( stage, object, timestamp );
   }
-      
-  device->unlock();
 }
 
 
@@ -205,14 +203,14 @@ LidarTrack::mergeStages( LidarDevices &devices, uint64_t timestamp )
 static void
 addToObjects( LidarDevice *device, LidarObjects &objects, int user )
 {
-  if ( !device->isOpen() || device->isEnvScanning || !device->dataValid )
+  const LidarObjectsFrame &frame( device->latestObjects() );
+
+  if ( !frame.valid )
     return;
   
-  device->lock();
-
-  for ( int oi = device->numDetectedObjects()-1; oi >= 0; --oi )
+  for ( int oi = ((int)frame.objects.size())-1; oi >= 0; --oi )
   { 
-    LidarObject &object( device->detectedObject( oi ) );
+    const LidarObject &object( frame.objects[oi] );
 
     objects.push_back( LidarObject(object) );
     LidarObject &obj( objects.back() );
@@ -220,7 +218,7 @@ addToObjects( LidarDevice *device, LidarObjects &objects, int user )
     obj.user = user;
       
     if ( g_RadialDisplacement != 0.0 )
-    { Vector3D offset( obj.center - device->matrix.w );
+    { Vector3D offset( obj.center - frame.origin );
       offset.normalize();
       obj.normal = offset;
 
@@ -228,8 +226,6 @@ addToObjects( LidarDevice *device, LidarObjects &objects, int user )
       obj.center += offset;
     }
   }
-      
-  device->unlock();
 }
 
 struct TrackInfo
@@ -496,6 +492,13 @@ LidarTrack::mergeObjects( LidarDevices &devices, uint64_t timestamp )
   const double confWeight      = 0.8;
   const double splitWeight     = 1.0;
   
+  const double timeOffsetBound = 4.0 * 0.25;	// bound of objTimeOffset()
+
+  objectGrid.clear( uniteDistance );
+  for ( int i = ((int)objects.size())-1; i >= 0; --i )
+    objectGrid.add( objects[i].center.x, objects[i].center.y, i );
+  objectGrid.build();
+
       /* calculate min distances between objects */
 
   std::vector<TrackInfo> trackInfo;
@@ -505,8 +508,11 @@ LidarTrack::mergeObjects( LidarDevices &devices, uint64_t timestamp )
     
     double obj0Weight = 1.0 - obj.confidence;
     
-    for ( int j = i-1; j >= 0; --j )
+    objectGrid.query( obj.center.x, obj.center.y, uniteDistance + timeOffsetBound, [&]( int j )
     { 
+      if ( j >= i )
+	return;
+
       LidarObject &obj1( objects[j] );
       double d  = obj.center.distance( obj1.center );
       
@@ -532,7 +538,7 @@ LidarTrack::mergeObjects( LidarDevices &devices, uint64_t timestamp )
       
       if ( d <= uniteDistance + timeOffset )
 	trackInfo.push_back( TrackInfo({d, i, j}) );
-    }
+    });
   }
       /* sort by distances */
   sort( trackInfo.begin(), trackInfo.end(), compareTrackInfo );
@@ -572,7 +578,8 @@ LidarTrack::mergeObjects( LidarDevices &devices, uint64_t timestamp )
 
   float objectMaxSize = m_Stage->objectMaxSize;
 
-  Trackables<BlobMarkerUnion> &merged( *new Trackables<BlobMarkerUnion>() );
+  Trackables<BlobMarkerUnion>::Ptr mergedPtr( stage.acquireTrackables() );
+  Trackables<BlobMarkerUnion> &merged( *mergedPtr );
 
   for ( int i = ((int)objects.size())-1; i >= 0; --i )
   {
@@ -581,16 +588,18 @@ LidarTrack::mergeObjects( LidarDevices &devices, uint64_t timestamp )
   }
 
   stage.finish( timestamp );
-  stage.latest = Trackables<BlobMarkerUnion>::Ptr( &merged );
+  stage.recycleTrackables( stage.latest );
+  stage.latest = mergedPtr;
 
-  Trackables<BlobMarkerUnion> &current( *new Trackables<BlobMarkerUnion>() );
+  Trackables<BlobMarkerUnion>::Ptr currentPtr( stage.acquireTrackables() );
+  Trackables<BlobMarkerUnion> &current( *currentPtr );
 
   for ( int i = ((int)objects.size())-1; i >= 0; --i )
   {
     LidarObject &object( objects[i] );
     
 
-    current.push_back( Trackable<BlobMarkerUnion>::Ptr( stage.createTrackable()) );
+    current.push_back( stage.allocTrackable() );
     Trackable<BlobMarkerUnion>::Ptr trackable = current.back();
 //    trackable->touchTime( timestamp );
 
@@ -610,8 +619,10 @@ LidarTrack::mergeObjects( LidarDevices &devices, uint64_t timestamp )
   }
 
   stage.lockCurrent();
-  stage.current = Trackables<BlobMarkerUnion>::Ptr( &current );
+  std::swap( stage.current, currentPtr );
   stage.unlockCurrent();
+
+  stage.recycleTrackables( currentPtr );
   
   m_Stage->unite( timestamp );
 }
@@ -628,6 +639,8 @@ LidarTrack::track( LidarDevices &devices, uint64_t timestamp )
   }
   else
   {
+    uint64_t mergeStart = LatencyTracer::usec();
+
     if ( uniteMethod == UniteObjects )
     { m_Stage->uniteInSingleStage = false;
       mergeObjects( devices, timestamp );
@@ -638,6 +651,28 @@ LidarTrack::track( LidarDevices &devices, uint64_t timestamp )
       mergeStages( devices, timestamp );
       m_Stage->unite( timestamp );
     }
+
+    uint64_t emitted = LatencyTracer::usec();
+    uint64_t merged  = emitted - mergeStart;
+    LatencyTracer::add( LatencyTracer::Merge, merged > m_Stage->observeDuration ? merged - m_Stage->observeDuration : 0 );
+
+    uint64_t oldestReceive = 0;
+    for ( int i = 0; i < devices.size(); ++i )
+    { LidarDevice &device( *devices[i] );
+      const LidarObjectsFrame &frame( device.objectsFrame.readBuffer() );	// the frame merged above
+
+	// frames merged again on later calls were counted already
+      if ( !frame.valid || frame.receiveTime == 0 || frame.receiveTime == device.trackedReceiveTime )
+	continue;
+
+      device.trackedReceiveTime = frame.receiveTime;
+
+      if ( oldestReceive == 0 || frame.receiveTime < oldestReceive )
+	oldestReceive = frame.receiveTime;
+    }
+
+    if ( m_Stage->observer != NULL && oldestReceive != 0 && emitted > oldestReceive )
+      LatencyTracer::add( LatencyTracer::Total, emitted - oldestReceive );
   }
 }
 
@@ -29,6 +29,11 @@ using namespace rp::standalone::rplidar;
 #define MSG_SCAN_DATA      (MSG_BASE|1)
 #define MSG_ENV_DATA       (MSG_BASE|2)
 #define MSG_CMD		   (MSG_BASE|3)
+#define MSG_SCAN_COMPACT   (MSG_BASE|4)
+#define MSG_ENV_COMPACT    (MSG_BASE|5)
+
+#define COMPACT_QUALITY_BITPLANE 0x01
+#define COMPACT_ANGLE_ESCAPE	 -128
 
 /***************************************************************************
 *** 
@@ -36,10 +41,15 @@ using namespace rp::standalone::rplidar;
 ***
 ****************************************************************************/
 
-static const int nodesPerPacket = 128;
+static const int nodesPerPacket        = 128;
+static const int compactNodesPerPacket = 240; // worst case encoding still fits into one ethernet frame
 
 static int g_Verbose = false;
 
+int LidarVirtualDriver::recvBatchSize  = 32;
+int LidarVirtualDriver::recvBufferSize = 0;
+bool LidarVirtualDriver::compactFormat = true;
+
 /***************************************************************************
 *** 
 *** Helper
@@ -169,23 +179,142 @@ public:
   
 };
 
+/***************************************************************************
+*** 
+*** LidarCompactScanMsg
+***
+****************************************************************************/
+
+/*
+  Compact packet layout following the LidarScanHeader:
+
+    _u8  flags
+    _u8  quality	 common quality if COMPACT_QUALITY_BITPLANE is set
+    _u16 angle		 angle_z_q14 of the first node
+    _u16 distance[n]	 in mm
+    quality		 one bit per node if COMPACT_QUALITY_BITPLANE, else one byte per node
+    angles		 per following node the change of the angle increment as int8,
+			 or COMPACT_ANGLE_ESCAPE followed by the absolute _u16 angle
+*/
+
+class LidarCompactScanMsg
+{
+public:
+  std::vector<unsigned char> buffer;
+
+  template <class T>
+  static void put( unsigned char *&dst, T value )
+  { memcpy( dst, &value, sizeof(value) ); dst += sizeof(value); }
+
+  LidarCompactScanMsg( _u64 type, _u64 seqNr, int packetId, int nodesPerPacket, int totalNodes, LidarRawSampleBuffer &nodes )
+  {
+    LidarScanHeader header( type, seqNr, packetId, nodesPerPacket, totalNodes );
+
+    int nodesInPacket = nodesPerPacket;
+
+    if ( (packetId+1)*nodesPerPacket > totalNodes )
+      nodesInPacket = totalNodes % nodesPerPacket;
+
+    buffer.resize( sizeof(header) + 4 + nodesInPacket * 6 );
+
+    unsigned char *dst = &buffer[0];
+
+    put( dst, header );
+
+    if ( nodesInPacket <= 0 )
+    { buffer.resize( sizeof(header) );
+      return;
+    }
+
+    const LidarRawSample *src = &nodes[packetId*nodesPerPacket];
+
+    _u8 flags   = COMPACT_QUALITY_BITPLANE;
+    _u8 quality = 0;
+
+    for ( int i = 0; i < nodesInPacket; ++i )
+    { _u8 q = src[i].quality;
+      if ( q != 0 )
+      { if ( quality == 0 )
+	  quality = q;
+	else if ( q != quality )
+        { flags = 0;
+	  break;
+	}
+      }
+    }
+
+    put( dst, flags );
+    put( dst, quality );
+    put( dst, (_u16) src[0].angle_z_q14 );
+
+    for ( int i = 0; i < nodesInPacket; ++i )
+    { _u32 mm = (src[i].dist_mm_q2 + 2) >> 2;
+      put( dst, (_u16) (mm < 0xffff ? mm : 0xffff) );
+    }
+
+    if ( flags & COMPACT_QUALITY_BITPLANE )
+    {
+      int numBytes = (nodesInPacket+7) / 8;
+      memset( dst, 0, numBytes );
+      for ( int i = 0; i < nodesInPacket; ++i )
+	if ( src[i].quality != 0 )
+	  dst[i/8] |= (1 << (i%8));
+      dst += numBytes;
+    }
+    else
+    {
+      for ( int i = 0; i < nodesInPacket; ++i )
+	put( dst, (_u8) src[i].quality );
+    }
+
+    int prevAngle = src[0].angle_z_q14;
+    int prevDelta = 0;
+
+    for ( int i = 1; i < nodesInPacket; ++i )
+    {
+      int angle = src[i].angle_z_q14;
+      int delta = (int16_t)(_u16)(angle - prevAngle);
+      int dd    = delta - prevDelta;
+
+      if ( dd > COMPACT_ANGLE_ESCAPE && dd <= 127 )
+	put( dst, (int8_t) dd );
+      else
+      { put( dst, (int8_t) COMPACT_ANGLE_ESCAPE );
+	put( dst, (_u16) angle );
+      }
+
+      prevAngle = angle;
+      prevDelta = delta;
+    }
+
+    buffer.resize( dst - &buffer[0] );
+  }
+};
+
 /***************************************************************************
 *** 
 *** LidarScanData
 ***
 ****************************************************************************/
 
+void
+LidarScanData::reset( _u64 seqNr )
+{
+  this->seqNr = seqNr;
+  used	      = true;
+  numPackets  = 0;
+  arrivalTime = 0;
+  packetsReceived.reset();
+  nodes.resize( 0 );
+}
+
 bool
 LidarScanData::complete() const
 {
-  if ( packetsReceived.size() == 0 )
+  if ( !used || numPackets == 0 )
     return false;
     
-  for ( int i = packetsReceived.size()-1; i >= 0; --i )
-    if ( !packetsReceived[i] )
-      return false;
-    
-  return true;
+  return packetsReceived.count() == numPackets;
 }
 
 void
@@ -197,26 +326,43 @@ LidarScanData::addData( unsigned char *data, int size )
   if ( numPackets == 0 || header.totalNodes % header.nodesPerPacket > 0 )
     numPackets += 1;
 
-  if ( header.packetId >= numPackets )
+  if ( header.packetId >= numPackets || numPackets > maxPackets )
     return;
 
-  if ( packetsReceived.size() == 0 )
-  { packetsReceived 	= std::vector<bool>( numPackets, false );
+  if ( this->numPackets == 0 )
+  { this->numPackets	= numPackets;
     seqNr		= header.seqNr;
     nodes.resize( header.totalNodes );
   }
     
-  if ( header.packetId >= packetsReceived.size() )
-    Lidar::error( "addData: header.packetId: %d packetsReceived.size(): %ld", header.packetId, packetsReceived.size() );
+  if ( header.packetId >= this->numPackets )
+  { Lidar::error( "addData: header.packetId: %d numPackets: %d", header.packetId, this->numPackets );
+    return;
+  }
 
   packetsReceived[header.packetId] = true;
+  arrivalTime = LatencyTracer::usec();
        
   int nodesInPacket = header.nodesPerPacket;
     
   if ( (header.packetId+1)*header.nodesPerPacket > header.totalNodes )
     nodesInPacket = header.totalNodes % header.nodesPerPacket;
 
-  if ( nodesInPacket > 0 )
+  if ( nodesInPacket > 0 && (header.type == MSG_SCAN_COMPACT || header.type == MSG_ENV_COMPACT) )
+  {
+    int nodeIndex = header.packetId*header.nodesPerPacket;
+    
+    if ( nodeIndex + nodesInPacket > nodes.size() )
+    { Lidar::error( "addData: received size: %d > nodes size %ld", nodeIndex + nodesInPacket, nodes.size() );
+      return;
+    }
+
+    if ( !decodeCompact( &data[sizeof(header)], size-sizeof(header), &nodes[nodeIndex], nodesInPacket ) )
+    { Lidar::error( "addData: compact packet %d of scan %ld is corrupt", header.packetId, header.seqNr );
+      packetsReceived[header.packetId] = false;
+    }
+  }
+  else if ( nodesInPacket > 0 )
   {
     if ( size != sizeof(header) + nodesInPacket * sizeof(LidarRawSample) )
       Lidar::error( "addData: received size: %d != calculated %ld", size, sizeof(header) + nodesInPacket * sizeof(LidarRawSample) );
@@ -232,35 +378,146 @@ LidarScanData::addData( unsigned char *data, int size )
 //    printf( "got(%d) %d/%d %d %d\n", header.seqNr, header.packetId, numPackets, header.nodesPerPacket, header.totalNodes );
 }
 
+bool
+LidarScanData::decodeCompact( const unsigned char *src, int size, LidarRawSample *dst, int numNodes )
+{
+  const unsigned char *end = src + size;
+
+  int qualityBytes = numNodes;
+  
+  if ( size < 4 + 2*numNodes )
+    return false;
+
+  _u8  flags   = src[0];
+  _u8  quality = src[1];
+  _u16 angle;
+  memcpy( &angle, &src[2], sizeof(angle) );
+  src += 4;
+
+  for ( int i = 0; i < numNodes; ++i, src += 2 )
+  { _u16 mm;
+    memcpy( &mm, src, sizeof(mm) );
+    dst[i].dist_mm_q2 = ((_u32) mm) << 2;
+  }
+
+  if ( flags & COMPACT_QUALITY_BITPLANE )
+    qualityBytes = (numNodes+7) / 8;
+
+  if ( end - src < qualityBytes )
+    return false;
+
+  if ( flags & COMPACT_QUALITY_BITPLANE )
+  { for ( int i = 0; i < numNodes; ++i )
+      dst[i].quality = ((src[i/8] >> (i%8)) & 1) ? quality : 0;
+  }
+  else
+  { for ( int i = 0; i < numNodes; ++i )
+      dst[i].quality = src[i];
+  }
+  src += qualityBytes;
+
+  dst[0].angle_z_q14 = angle;
+
+  int prevAngle = angle;
+  int prevDelta = 0;
+
+  for ( int i = 1; i < numNodes; ++i )
+  {
+    if ( src >= end )
+      return false;
+
+    int dd = (int8_t) *src++;
+    int a;
+
+    if ( dd == COMPACT_ANGLE_ESCAPE )
+    { if ( end - src < 2 )
+	return false;
+      memcpy( &angle, src, sizeof(angle) );
+      src += 2;
+      a = angle;
+    }
+    else
+      a = (_u16)(prevAngle + prevDelta + dd);
+
+    dst[i].angle_z_q14 = a;
+
+    prevDelta = (int16_t)(_u16)(a - prevAngle);
+    prevAngle = a;
+  }
+
+  return true;
+}
+
 /***************************************************************************
 *** 
 *** LidarScanDataList
 ***
 ****************************************************************************/
 
-LidarScanData &
+LidarScanDataList::LidarScanDataList()
+  : currentSeqNr( 0 ),
+    currentValid( false ),
+    seqFailureCount( 0 ),
+    arrivalTime ( 0 ),
+    numCompleted( 0 ),
+    numEvicted  ( 0 ),
+    numStale    ( 0 ),
+    numLate     ( 0 )
+{
+}
+
+void
+LidarScanDataList::evict( LidarScanData &scanData, std::atomic<uint64_t> &counter )
+{
+  if ( scanData.used )
+  { scanData.used = false;
+    counter += 1;
+  }
+}
+
+void
+LidarScanDataList::reset( _u64 seqNr )
+{
+  currentSeqNr = seqNr;
+  currentValid = false;
+  
+  for ( int i = 0; i < ringSize; ++i )
+    slots[i].used = false;
+}
+
+LidarScanData *
 LidarScanDataList::getScanData( _u64 seqNr )
 {
-  for ( int i = ((int)size())-1; i >= 0; --i )
-    if ( (*this)[i].seqNr == seqNr )
-      return (*this)[i];
+  LidarScanData &scanData( slots[seqNr % ringSize] );
 
-  if ( size() > 16 )
-    erase( begin() );
+  if ( scanData.used && scanData.seqNr == seqNr )
+    return &scanData;
 
-  for ( int i = ((int)size())-1; i >= 0; --i )
+  if ( currentValid && seqNr <= currentSeqNr )
   {
-    if ( (*this)[i].seqNr < seqNr )
-    {
-      emplace( begin()+i+1, seqNr );
-      
-      return (*this)[i+1];
+    if ( currentSeqNr - seqNr <= restartGap )
+    { numLate += 1;		// late packet or duplicate of a scan already handed out
+      return NULL;
     }
+    
+    if ( g_Verbose > 0 )
+      Lidar::info( "scanData: seqNr restarted at %ld after %ld", seqNr, currentSeqNr );
+
+    reset( seqNr );
+  }
+  else if ( scanData.used && scanData.seqNr > seqNr )
+  { numLate += 1;		// never evict a newer scan still being assembled
+    return NULL;
   }
 
-  emplace( begin(), seqNr );
+  if ( scanData.used && g_Verbose > 1 )
+    Lidar::info( "evict scanData: %ld by %ld", scanData.seqNr, seqNr );
+
+  evict( scanData, numEvicted );
 
-  return (*this)[0];
+  scanData.reset( seqNr );
+
+  return &scanData;
 }
 
 
@@ -268,37 +525,59 @@ bool
 LidarScanDataList::grabScanData( LidarRawSampleBuffer &nodes, bool grabLatest )
 {
   bool success = false;
-  
-  for ( int i = 0; i < size(); ++i )
+
+  LidarScanData *complete[ringSize];
+  int		 numComplete = 0;
+
+      /* complete scans in ascending seqNr order */
+  for ( int i = 0; i < ringSize; ++i )
   {
-    LidarScanData &scanData( (*this)[i] );
+    LidarScanData &scanData( slots[i] );
     
-    if ( scanData.complete() )
+    if ( !scanData.complete() )
+      continue;
+
+    int j = numComplete++;
+    for ( ; j > 0 && complete[j-1]->seqNr > scanData.seqNr; --j )
+      complete[j] = complete[j-1];
+    complete[j] = &scanData;
+  }
+
+  for ( int i = 0; i < numComplete; ++i )
+  {
+    LidarScanData &scanData( *complete[i] );
+    
+    //      printf( "complete: %d  %ld %ld\n", scanData.seqNr < currentSeqNr, scanData.seqNr, currentSeqNr );
+
+    if ( scanData.seqNr < currentSeqNr && (seqFailureCount += 1) < 15 )
+      evict( scanData, numStale );
+    else
     {
-      //      printf( "complete: %d  %ld %ld\n", scanData.seqNr < currentSeqNr, scanData.seqNr, currentSeqNr );
+      seqFailureCount = 0;
 
-      if ( scanData.seqNr < currentSeqNr && (seqFailureCount += 1) < 15 )
-      { erase( begin()+i );
-	i -= 1;
-      }
-      else
-      {
-	seqFailureCount = 0;
+	  /* hand the frame over by swapping storage, the slot keeps the old buffer of nodes */
+      nodes.swap( scanData.nodes );
+      currentSeqNr = scanData.seqNr;
+      currentValid = true;
+      arrivalTime  = scanData.arrivalTime;
+      success = true;
 
-	nodes        = scanData.nodes;
-	currentSeqNr = scanData.seqNr;
-	success = true;
+      scanData.used = false;
+      numCompleted += 1;
       
-	erase( begin()+i );
-
-	if ( !grabLatest )
-	  return true;
-	
-	i -= 1;
-      }
+      if ( !grabLatest )
+	break;
     }
   }
 
+  if ( success )
+  {
+        /* incomplete scans older than the one handed out will never be used */
+    for ( int i = 0; i < ringSize; ++i )
+      if ( slots[i].used && slots[i].seqNr < currentSeqNr )
+	evict( slots[i], numEvicted );
+  }
+
   return success;
 }
 
@@ -319,8 +598,11 @@ LidarVirtualDriver::LidarVirtualDriver( bool isInDevice )
     isInDevice( isInDevice ),
     isOpen    ( false ),
     deviceStatusSent( false ),
+    peerCompactFormat( false ),
     seqNr( 0 )
 {
+  udpSocket.setReceiveBatch( recvBatchSize );
+  udpSocket.setReceiveBufferSize( recvBufferSize );
 }
   
 void
@@ -369,7 +651,13 @@ LidarVirtualDriver::sendConnect()
   lastRemoteAddr = udpSocket.remote_addr;
   deviceStatusSent = false;
   
-  return sendCmd( "connect" );
+  bool success = sendCmd( "connect" );
+
+      /* tell the sender that compact scan packets are understood, old senders ignore it */
+  if ( isInDevice && compactFormat )
+    sendCmd( "compactFormat" );
+
+  return success;
 }
 
 bool
@@ -464,6 +752,21 @@ LidarVirtualDriver::sendScanData( LidarRawSampleBuffer &nodes, bool isEnv )
   
   bool success = true;
   
+  if ( peerCompactFormat )
+  {
+    numPackets = count / compactNodesPerPacket;
+    if ( count == 0 || (count % compactNodesPerPacket) != 0 )
+      numPackets += 1;
+  
+    for ( int i = 0; i < numPackets; ++i )
+    {
+      LidarCompactScanMsg msg( isEnv ? MSG_ENV_COMPACT : MSG_SCAN_COMPACT, seqNr, i, compactNodesPerPacket, count, nodes );
+      success = (send( (const char *)&msg.buffer[0], msg.buffer.size() ) && success);
+    }
+
+    return success;
+  }
+
   for ( int i = 0; i < numPackets; ++i )
   {
     LidarScanMsg msg( isEnv ? MSG_ENV_DATA : MSG_SCAN_DATA, seqNr, i, nodesPerPacket, count, nodes );
@@ -499,12 +802,16 @@ LidarVirtualDriver::update( int timeout_ms )
       return;
   }
   
-  bool success = udpSocket.receiveNextPacket( timeout_ms );
+  int  numPackets  = udpSocket.receivePackets( timeout_ms );
+  int  packetIndex = 0;
+  bool success     = (numPackets > 0);
 
   uint64_t currentTime = getmsec();
 
   while ( success )
   {
+    udpSocket.selectPacket( packetIndex++ );
+
     lastRecvTime = currentTime;
 
     _u64 type = ((_u64*)udpSocket.packetData())[0];
@@ -522,16 +829,20 @@ LidarVirtualDriver::update( int timeout_ms )
 	else
 	  sendPowerUpState();
 	
-	scanDataList.currentSeqNr = 0;
+	scanDataList.reset();
+	peerCompactFormat = false;
 	sendConnectAcknowledge();
       }
+      else if ( strcmp(cmd,"compactFormat") == 0 )
+	peerCompactFormat = (!isInDevice && compactFormat);
 
-      cmdQueue.push( cmd );
+      if ( strcmp(cmd,"compactFormat") != 0 )
+	cmdQueue.push( cmd );
       
       if ( g_Verbose > 0 )
 	Lidar::info( "got cmd '%s'", cmd );
     }
-    else if ( type == MSG_SCAN_DATA || type == MSG_ENV_DATA )
+    else if ( type == MSG_SCAN_DATA || type == MSG_ENV_DATA || type == MSG_SCAN_COMPACT || type == MSG_ENV_COMPACT )
     {
       if ( udpSocket.packetSize() < sizeof(LidarScanHeader) )
 	 Lidar::error( "udpSocket.packetSize() %ld < %ld", udpSocket.packetSize(), sizeof(LidarScanHeader) );
@@ -539,8 +850,10 @@ LidarVirtualDriver::update( int timeout_ms )
       LidarScanHeader header;
       memcpy( (void*)&header, (void*)udpSocket.packetData(), sizeof(header) );
 
-      if ( header.nodesPerPacket != nodesPerPacket )
-	Lidar::error( "header.nodesPerPacket %d != %d", header.nodesPerPacket, nodesPerPacket );
+      bool isCompact = (type == MSG_SCAN_COMPACT || type == MSG_ENV_COMPACT);
+
+      if ( header.nodesPerPacket != (isCompact ? compactNodesPerPacket : nodesPerPacket) )
+	Lidar::error( "header.nodesPerPacket %d != %d", header.nodesPerPacket, (isCompact ? compactNodesPerPacket : nodesPerPacket) );
 
       if ( header.nodesPerPacket > 0 && header.totalNodes < 500000 ) // plausible data test
       {
@@ -552,22 +865,29 @@ LidarVirtualDriver::update( int timeout_ms )
 	if ( header.totalNodes == 0 || header.totalNodes % header.nodesPerPacket > 0 )
 	  numPackets += 1;
       
-	LidarScanData &scanData = (type == MSG_SCAN_DATA ? scanDataList.getScanData(header.seqNr) : envDataList.getScanData(header.seqNr) );
-	
-	if ( &scanData == NULL )
-	  Lidar::error( "scanData == NULL" );
+	bool isScan = (type == MSG_SCAN_DATA || type == MSG_SCAN_COMPACT);
 
-	scanData.addData( (unsigned char *)udpSocket.packetData(), udpSocket.packetSize() );
+	LidarScanData *scanData = (isScan ? scanDataList.getScanData(header.seqNr) : envDataList.getScanData(header.seqNr) );
+	
+	if ( scanData != NULL )
+	{
+	  scanData->addData( (unsigned char *)udpSocket.packetData(), udpSocket.packetSize() );
 	
-	if ( g_Verbose > 0 && scanData.complete() )
-	  Lidar::info( "recv scanData: %d", scanData.seqNr );
+	  if ( g_Verbose > 0 && scanData->complete() )
+	    Lidar::info( "recv scanData: %d", scanData->seqNr );
+	}
       }
     }
 
     if ( lastRemoteAddr != udpSocket.remote_addr && !udpSocket.remote_addr.empty() )
       sendConnect();
     
-    success = udpSocket.receiveNextPacket( 0 );
+    if ( packetIndex >= numPackets )
+    { numPackets  = udpSocket.receivePackets( 0 );
+      packetIndex = 0;
+    }
+
+    success = (numPackets > 0);
   }
 
 /*
@@ -129,6 +129,18 @@ TrackableHUB::decodePacket( unsigned char *in, size_t len )
       break;
     }
 
+    case PackedTrackable::DeltaHeader:
+    {
+      PackedTrackable::BinaryFrame frame;
+
+	// deltas are dropped until the next key frame
+      if ( !m_DeltaDecoder.decode( in, len, frame ) )
+	return false;
+
+      observe( frame );
+      break;
+    }
+
     default:
     {
       printf( "unknown header type\n" );
@@ -174,6 +186,7 @@ static int callback_client( struct lws *wsi, enum lws_callback_reasons reason, v
       if ( g_Verbose )
 	printf("[Main Service] LWS_CALLBACK_CLOSED\n");
       web_socket = NULL;
+      TrackableHUB::instance()->m_DeltaDecoder.reset();
       break;
     }
 
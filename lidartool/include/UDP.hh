@@ -38,8 +38,10 @@
 #include <cassert>
 #include <string>
 #include <vector>
+#include <atomic>
 #include <iostream>
 #include <unistd.h>
+#include <sys/uio.h>
 
 /** a wrapper class for holding an ip address, mostly used internnally */
 class SockAddr
@@ -127,7 +129,21 @@ struct UdpSocket {
   std::vector<char> buffer;
   std::vector<char> rcvBuffer;
 
-  UdpSocket() : handle(-1)
+  /* batched receive: recvmmsg() fills a ring of fixed size packet slots */
+  std::vector<char>     ringBuffer;
+  std::vector<mmsghdr>  ringMsgs;
+  std::vector<iovec>    ringIovecs;
+  std::vector<SockAddr> ringOrigins;
+  std::vector<int>      ringValid;   /* ring slots of the datagrams of the last batch that were not truncated */
+  int  ringSlotSize;
+  int  rcvBufSize;      /* SO_RCVBUF in bytes, 0 keeps the system default */
+  bool batchReceived;   /* last receivePackets() call used the ring */
+  std::atomic<uint64_t> numTruncated; /* datagrams dropped because they exceeded the slot size */
+
+  const char *currentData;
+  size_t      currentSize;
+
+  UdpSocket() : handle(-1), ringSlotSize(0), rcvBufSize(0), batchReceived(false), numTruncated(0), currentData(0), currentSize(0)
   { 
     rcvBuffer.resize( 0xffff );
   }
@@ -197,6 +213,131 @@ struct UdpSocket {
   { if (error_message.empty()) error_message = msg;
   }
 
+  /** set the kernel receive buffer size. Applied immediately if the socket
+      is open, otherwise when it is opened. */
+  bool setReceiveBufferSize(int bytes)
+  {
+    rcvBufSize = bytes;
+    if ( handle == -1 || rcvBufSize <= 0 )
+      return true;
+
+    return setsockopt( handle, SOL_SOCKET, SO_RCVBUF, &rcvBufSize, sizeof(rcvBufSize) ) == 0;
+  }
+
+  /** enable batched receiving of up to numPackets datagrams per syscall with
+      receivePackets(). Datagrams larger than slotSize are dropped and counted
+      in numTruncated.
+      A numPackets <= 1 falls back to receiveNextPacket(). */
+  void setReceiveBatch(int numPackets, int slotSize = 4096)
+  {
+    if ( numPackets <= 1 )
+    { ringMsgs.clear();
+      return;
+    }
+
+    ringSlotSize = slotSize;
+    ringBuffer .resize( numPackets * slotSize );
+    ringMsgs   .resize( numPackets );
+    ringIovecs .resize( numPackets );
+    ringOrigins.resize( numPackets );
+    ringValid  .reserve( numPackets );
+
+    for ( int i = 0; i < numPackets; ++i )
+    { ringIovecs[i].iov_base = &ringBuffer[i*slotSize];
+      ringIovecs[i].iov_len  = slotSize;
+      memset( &ringMsgs[i], 0, sizeof(mmsghdr) );
+      ringMsgs[i].msg_hdr.msg_iov    = &ringIovecs[i];
+      ringMsgs[i].msg_hdr.msg_iovlen = 1;
+      ringMsgs[i].msg_hdr.msg_name   = &ringOrigins[i].addr();
+    }
+  }
+
+  /** wait up to timeout_ms for the socket to become readable, -1 waits forever */
+  bool waitReadable(int timeout_ms)
+  {
+    if (timeout_ms < 0)
+      return true;
+
+    struct timeval tv; memset(&tv, 0, sizeof tv);
+    tv.tv_sec=timeout_ms/1000;
+    tv.tv_usec=(timeout_ms%1000) * 1000;
+
+    fd_set readset;
+    FD_ZERO(&readset);
+    FD_SET(handle, &readset);
+
+    return select( handle+1, &readset, 0, 0, &tv ) > 0;
+  }
+
+  /** receive all datagrams available, at most the batch size, waiting up to
+      timeout_ms for the first one. Returns the number of datagrams, which are
+      then made current one by one with selectPacket().
+  */
+  int receivePackets(int timeout_ms = -1)
+  {
+    batchReceived = false;
+
+    if ( ringMsgs.empty() )
+      return receiveNextPacket( timeout_ms ) ? 1 : 0;
+
+    if ( !isOk() || handle == -1 )
+    { setErr("not opened.."); 
+      return 0;
+    }
+
+    if ( timeout_ms > 0 && !waitReadable( timeout_ms ) )
+      return 0;
+
+    for ( int i = (int)ringMsgs.size()-1; i >= 0; --i )
+      ringMsgs[i].msg_hdr.msg_namelen = (socklen_t)ringOrigins[i].maxLength();
+
+    int flags = (timeout_ms < 0 ? MSG_WAITFORONE : MSG_DONTWAIT);
+    int count = recvmmsg( handle, &ringMsgs[0], (unsigned int)ringMsgs.size(), flags, 0 );
+
+    if (count < 0)
+    {
+      if (errno != EAGAIN && errno != EINTR && errno != EWOULDBLOCK &&
+          errno != ECONNRESET && errno != ECONNREFUSED)
+        setErr(strerror(errno));
+
+      if ( !isOk() )
+	close();
+
+      return 0;
+    }
+
+    /* a truncated datagram is skipped, the rest of the batch is still valid */
+    ringValid.clear();
+    for ( int i = 0; i < count; ++i )
+    {
+      if ( ringMsgs[i].msg_hdr.msg_flags & MSG_TRUNC )
+        numTruncated += 1;
+      else
+        ringValid.push_back( i );
+    }
+
+    batchReceived = !ringValid.empty();
+
+    return (int)ringValid.size();
+  }
+
+  /** make the i-th datagram of the last receivePackets() call the current
+      packet and its sender the remote address */
+  void selectPacket(int i)
+  {
+    if ( !batchReceived )
+    { currentData = (buffer.empty() ? 0 : &buffer[0]);
+      currentSize = buffer.size();
+      return;
+    }
+
+    i = ringValid[i];
+
+    currentData = &ringBuffer[i*ringSlotSize];
+    currentSize = ringMsgs[i].msg_len;
+    remote_addr = ringOrigins[i];
+  }
+
   /** wait for the next datagram to arrive on our bound socket. Return
       false in case of failure, or timeout. When the timeout_ms is set
       to -1, it will wait forever.
@@ -212,22 +353,8 @@ struct UdpSocket {
     }
 
     /* check if something is available */
-    if (timeout_ms >= 0)
-    {
-      struct timeval tv; memset(&tv, 0, sizeof tv);
-      tv.tv_sec=timeout_ms/1000;
-      tv.tv_usec=(timeout_ms%1000) * 1000;
-      
-      //gettimeofday(&tv, 0); //tv.tv_usec += timeout_ms*1000;
-
-      fd_set readset;
-      FD_ZERO(&readset);
-      FD_SET(handle, &readset);
-
-      int ret = select( handle+1, &readset, 0, 0, &tv );
-      if ( ret <= 0 ) // error, or timeout
-        return false;
-    }
+    if ( !waitReadable( timeout_ms ) ) // error, or timeout
+      return false;
 
     /* now we should be able to read without blocking.. */
     socklen_t len = (socklen_t)remote_addr.maxLength();
@@ -262,15 +389,18 @@ struct UdpSocket {
 	memcpy( (void*)&buffer[0], (void*)&rcvBuffer[0], nread );
     }
 
+    currentData = (buffer.empty() ? 0 : &buffer[0]);
+    currentSize = buffer.size();
+
     return true;
   }
 
   void *packetData()
-  { return buffer.empty() ? 0 : &buffer[0];
+  { return (void *) currentData;
   }
 
   size_t packetSize()
-  { return buffer.size();
+  { return currentSize;
   }
 
   SockAddr &packetOrigin()
@@ -350,6 +480,9 @@ private:
       if (handle == -1)
         continue;
 
+      if (rcvBufSize > 0)
+        setsockopt(handle, SOL_SOCKET, SO_RCVBUF, &rcvBufSize, sizeof(rcvBufSize));
+
       if (binding)
       {
         if (bind(handle, rp->ai_addr, (socklen_t)rp->ai_addrlen) != 0)
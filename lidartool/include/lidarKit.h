@@ -35,8 +35,13 @@
 #include <functional>
 #include <mutex>
 #include <thread>
+#include <atomic>
+#include <condition_variable>
 
 #include "keyValueMap.h"
+#include "latencyTracer.h"
+#include "workStealingPool.h"
+#include "trackAssignment.h"
 #include "Vector.h"
 
 #include "rplidar.h" //RPLIDAR standard sdk, all-in-one header
@@ -134,6 +139,20 @@ public:
 
 class LidarSampleBuffer;
 
+class LidarSampleSpan	// run of valid samples found by detectObjects()
+{
+public:
+  int		lowerIndex;
+  int		higherIndex;	// exceeds numSamples if the span crosses 0 degree
+  float		closest;
+
+  LidarSampleSpan( int index=0, float distance=0.0f )
+  : lowerIndex ( index ),
+    higherIndex( index ),
+    closest    ( distance )
+  {}
+};
+
 class LidarObject
 {
 public:
@@ -145,6 +164,7 @@ public:
   float		confidence;
   float		personSized;
   float		curvature;
+  float		scatter;
   float		extent;
   float		closest;
   float		angle;
@@ -164,6 +184,7 @@ public:
     confidence ( 0.0 ),
     personSized( 0.0 ),
     curvature  ( 0.0 ),
+    scatter    ( 0.0 ),
     extent     ( extent ),
     closest    ( 0.0 ),
     angle      (),
@@ -174,9 +195,6 @@ public:
     timeStamp  ( 0 )
     {}
   
-  float lineScatter( LidarSampleBuffer &sampleBuffer ) const;
-  void  calcCurvature( LidarSampleBuffer &sampleBuffer );
-  
   float distance( const LidarObject &other ) const
   {
     float distance0 = lowerCoord.distance(other.lowerCoord)  + higherCoord.distance(other.higherCoord);
@@ -228,6 +246,8 @@ public:
 
 };
 
+class LidarObjectFeatures;
+
 class LidarObjects : public std::vector<LidarObject>
 {
 protected:
@@ -270,11 +290,169 @@ public:
   bool		calcTransformTo     ( const LidarObjects &other, Matrix3H &meMatrix, Matrix3H &otMatrix, float &minDistance ) const;
   
   LidarObjects  unscatter( LidarSampleBuffer &sampleBuffer ) const;
+
+	// arena of the calling thread, reused by unscatter() and calcCurvature()
+  static LidarObjectFeatures &features();
   
   Marker 	getMarker( LidarSampleBuffer &sampleBuffer ) const;
 
 };
 
+/***************************************************************************
+*** 
+*** LidarObjectFeatures
+***
+****************************************************************************/
+
+	// scratch arena for the per frame object features. The valid sample
+	// coordinates of all objects are gathered into contiguous arrays once,
+	// curvature and line scatter are then computed in a single pass over them
+
+class LidarObjectFeatures
+{
+public:
+  std::vector<float>	x;
+  std::vector<float>	y;
+  std::vector<int>	begin;		// first coordinate of each object, begin[numObjects] is the end
+  std::vector<float>	sumX;		// prefix sums of x and y for the split search
+  std::vector<float>	sumY;
+  std::vector<int>	validCount;	// number of valid samples up to each sample of the split range
+
+  void		extract   ( LidarObjects &objects, LidarSampleBuffer &sampleBuffer );
+  int		splitIndex( LidarSampleBuffer &sampleBuffer, int lowerIndex, int higherIndex, int firstIndex, int lastIndex );
+
+  static float	curvature ( const Vector2D &first, const Vector2D &mean, const Vector2D &last );
+};
+
+
+/***************************************************************************
+*** 
+*** LidarTripleBuffer
+***
+****************************************************************************/
+
+/*
+  Wait-free hand-off of frames from one producer thread to one consumer
+  thread. The producer fills writeBuffer() and publishes it, the consumer
+  picks up the latest published frame with update(). Neither side blocks.
+*/
+
+template <class T>
+class LidarTripleBuffer
+{
+protected:
+  static const int	 indexMask = 3;
+  static const int	 freshBit  = 4;
+
+  T			 slots[3];
+  std::atomic<int>	 middle;
+  int			 back;
+  int			 front;
+
+public:
+  LidarTripleBuffer()
+  : middle( 1 ),
+    back  ( 0 ),
+    front ( 2 )
+  {}
+
+  T	  &writeBuffer()
+  { return slots[back]; }
+
+  void	   publish()
+  { back = middle.exchange( back | freshBit, std::memory_order_acq_rel ) & indexMask; }
+
+  bool	   update()
+  { if ( !(middle.load( std::memory_order_acquire ) & freshBit) )
+      return false;
+    front = middle.exchange( front, std::memory_order_acq_rel ) & indexMask;
+    return true;
+  }
+
+  const T &readBuffer() const
+  { return slots[front]; }
+};
+
+/***************************************************************************
+*** 
+*** LidarFrameSignal
+***
+****************************************************************************/
+
+/*
+  Wakes up the tracker as soon as a device thread published a new frame.
+*/
+
+class LidarFrameSignal
+{
+protected:
+  std::mutex			mutex;
+  std::condition_variable	cond;
+  uint64_t			count;
+
+public:
+  LidarFrameSignal()
+  : count( 0 )
+  {}
+
+  void	notify();
+  bool	wait( const std::function<bool()> &ready, uint64_t timeoutUSec );
+};
+
+/***************************************************************************
+*** 
+*** LidarObjectsFrame
+***
+****************************************************************************/
+
+class LidarObjectsFrame
+{
+public:
+  bool		valid;
+  uint64_t	timeStamp;
+  uint64_t	receiveTime;	// monotonic usec the driver delivered the scan
+  Vector3D	origin;
+  LidarObjects	objects;
+
+  LidarObjectsFrame()
+  : valid      ( false ),
+    timeStamp  ( 0 ),
+    receiveTime( 0 ),
+    origin     (),
+    objects    ()
+  {}
+};
+
+/***************************************************************************
+*** 
+*** LidarScanFrame
+***
+****************************************************************************/
+
+// raw scan as received by the I/O part of a device thread, handed over to
+// processScan() inline or on the compute pool
+
+class LidarScanFrame
+{
+public:
+  LidarRawSampleBuffer	nodes;
+  bool			result;
+  bool			clearData;
+  bool			isEnvData;
+  uint64_t		now;
+  uint64_t		samplesTimeStamp;
+  uint64_t		receiveTime;
+
+  LidarScanFrame()
+  : nodes           (),
+    result          ( false ),
+    clearData       ( false ),
+    isEnvData       ( false ),
+    now             ( 0 ),
+    samplesTimeStamp( 0 ),
+    receiveTime     ( 0 )
+  {}
+};
 
 /***************************************************************************
 *** 
@@ -348,6 +526,149 @@ public:
 };
 
 
+/***************************************************************************
+*** 
+*** LidarBinDirections
+***
+****************************************************************************/
+
+/*
+  Unit direction of every angle bin already multiplied by the linear part of
+  the device matrix. Rebuilt only when the matrix changes, so the world
+  coordinate of a sample is origin + distance * dir[angIndex].
+*/
+
+class LidarBinDirections
+{
+public:
+  std::vector<Vector2D> dir;
+  Vector2D		origin;
+
+  void update( const Matrix3H &matrix, int numSamples );
+
+  Vector3D coord( int angIndex, float distance ) const
+  { const Vector2D &d( dir[angIndex] );
+    return Vector3D( origin.x + distance * d.x, origin.y + distance * d.y, 0.0 );
+  }
+};
+
+/***************************************************************************
+*** 
+*** LidarSampleColumns
+***
+****************************************************************************/
+
+/*
+  Column (structure of arrays) layout of one scan in node order. The raw
+  nodes are converted column wise with a 4-wide SIMD kernel (SSE2/NEON) and
+  only afterwards scattered into the angle binned LidarSampleBuffer, which
+  stays the view used by detection, environment and painting.
+*/
+
+class LidarSampleColumns
+{
+public:
+  int			size;
+  std::vector<float>	angle;
+  std::vector<float>	distance;
+  std::vector<float>	x;
+  std::vector<float>	y;
+  std::vector<int>	quality;
+  std::vector<int>	angIndex;
+
+  LidarSampleColumns( int capacity=3*1024 )
+  : size( 0 )
+  { reserve( capacity ); }
+
+  void reserve( int capacity );
+  void convert( const LidarRawSampleBuffer &nodes, double char1, double char2, const LidarBinDirections &directions, int numSamples );
+};
+
+/***************************************************************************
+*** 
+*** LidarSampleHistory
+***
+****************************************************************************/
+
+/*
+  One bit per angle bin and frame, set if the bin reported a sample below
+  the quality threshold. Bit 0 is the current frame. A sample is temporal
+  noise if at least minCount of the previous depth-1 frames had a dropout.
+*/
+
+class LidarSampleHistory
+{
+public:
+  static const int	maxDepth = 32;
+
+  std::vector<uint32_t> noise;
+  int			depth;
+  int			minCount;
+  uint32_t		mask;
+
+  LidarSampleHistory()
+  : noise   (),
+    depth   ( 0 ),
+    minCount( 0 ),
+    mask    ( 0 )
+  { setDepth( 3 ); }
+
+  void setDepth( int depth, int minCount=1 );
+  void resize  ( int numSamples );
+  void push    ( const LidarSampleColumns &columns, int minQuality );
+
+  bool isNoise( int angIndex ) const
+  { uint32_t bits = noise[angIndex] & mask;
+    return bits != 0 && __builtin_popcount( bits ) >= minCount;
+  }
+};
+
+/***************************************************************************
+*** 
+*** LidarEnvMixture
+***
+****************************************************************************/
+
+// per bin mixture of a few distance modes learned online, so alternating
+// backgrounds like doors or curtains become environment without a rescan.
+// A sample is environment if it matches a mode with at least minWeight or
+// lies behind the farthest such mode.
+
+class LidarEnvMixture
+{
+public:
+  static const int	numModes = 3;
+
+  bool			enabled;
+  float			learnSec;	// time for a new mode to reach full weight
+  float			minWeight;	// weight of a mode to be environment
+  float			matchSigma;	// match distance in standard deviations
+
+  std::vector<float>	mean;		// mode k of bin i at i*numModes+k
+  std::vector<float>	var;
+  std::vector<float>	weight;
+  uint64_t		lastTime;
+
+  LidarEnvMixture()
+  : enabled   ( false ),
+    learnSec  ( 60.0 ),
+    minWeight ( 0.2 ),
+    matchSigma( 2.5 ),
+    mean      (),
+    var       (),
+    weight    (),
+    lastTime  ( 0 )
+  {}
+
+  void  resize( int numSamples );
+  void  seed  ( int angIndex, float distance );
+  void  clear ( int angIndex );
+  float alpha ( uint64_t timestamp );
+  void  update( int angIndex, float distance, float alpha, float minTolerance );
+  bool  isBackground( int angIndex, float distance, float minTolerance ) const;
+};
+
+
 /***************************************************************************
 *** 
 *** LidarBasisChange
@@ -504,14 +825,31 @@ public:
   bool			 isPoweringUp;
   bool   		 powerOff;
   bool   		 ready;
-  bool   		 dataReceived;
+  std::atomic<bool>	 dataReceived;
   bool   		 isSimulationMode;
  
   std::string		 errorMsg; 
   
   int 			 sampleBufferIndex;
   std::vector<LidarSampleBuffer>      samples;
+  LidarScanFrame	 scanFrames[2];
+  int			 scanFrameIndex;	// frame the I/O part receives into
+  int			 computeSlot;
+  bool			 scanProcessing;	// a frame is queued or processed on the compute pool
+  std::mutex		 scanMutex;
+  std::condition_variable scanCond;
+  ScanData		 scanPoints;
+  LidarSampleColumns	 scanColumns;
+  std::vector<LidarSampleSpan> sampleSpans;
+  LidarObjectFeatures	 objectFeatures;
   LidarObjects 	 	 objects;
+  LidarTripleBuffer<LidarObjectsFrame> objectsFrame;
+  bool			 objectsFrameValid;
+  uint64_t		 scanReceiveTime;
+  std::atomic<uint32_t>	 publishedFrames;
+  std::atomic<bool>	 framesActive;
+  uint32_t		 consumedFrames;
+  uint64_t		 trackedReceiveTime;	// receiveTime of the last frame counted in the Total latency
 
   std::mutex		 mutex;
   std::thread		*thread;
@@ -552,13 +890,6 @@ public:
 
   } info;
   
-  struct TrackInfo
-  {
-    double distance;
-    int    detectedIndex;
-    int    objectIndex;
-  };
-
   class UARTAutoPower 
   {
     public:
@@ -571,7 +902,6 @@ public:
   
   bool			 setUARTPower( bool on, const char *deviceName=NULL );
 
-  static bool 		 compareTrackInfo(const TrackInfo& t1, const TrackInfo& t2) { return t1.distance < t2.distance; }
   bool			 setDeviceParam( std::map<std::string, std::string> map );
   bool			 setDeviceDefaultParam( const char *deviceType );
 
@@ -664,12 +994,24 @@ public:
   Matrix3H		 matrixInverse;
   Matrix3H		 deviceMatrix;
   Matrix3H		 viewMatrix;
+  LidarBinDirections	 binDirections;
+  LidarSampleHistory	 sampleHistory;
+  LidarEnvMixture	 envMixture;
   LidarSampleBuffer   &sampleBuffer( int i=-1 ) const;
 
   LidarSampleBuffer	 envSamples;
   LidarSampleBuffer	 envRawSamples;
   LidarSampleBuffer	 envErodedSamples;
+  LidarSampleBuffer	 envFilteredSamples;
   LidarSampleBuffer	 envDSamples;
+  std::vector<float>	 envDistance;		// env distance per bin, INFINITY without env
+  int			 envDistanceQuality;	// minQuality envDistance was built with
+  std::vector<float>	 scanDistance;		// distance and quality of the current scan per bin
+  std::vector<float>	 scanQuality;
+  std::vector<uint32_t>	 scanValidMask;		// validity bit per bin of the current scan, see classifyScan()
+  std::vector<char>	 envDirty;		// raw env bins changed since the last processEnv()
+  std::vector<int>	 envDirtyBins;
+  bool			 envFilterValid;	// envErodedSamples matches envRawSamples outside the dirty bins
   uint64_t 		*envTimeStamps;
     
 
@@ -683,6 +1025,8 @@ public:
   float	 		 objectMinExtent;
   float	 		 objectMaxExtent;
   float	 		 objectTrackDistance;
+  bool	 		 objectOptimalAssignment;
+  TrackAssignment	 objectAssignment;
 
   bool		 	 shouldOpen;
   bool		 	 openFailed;
@@ -697,7 +1041,7 @@ public:
   bool		 	 doObjectTracking;
   bool		 	 doEnvAdaption;
   
-  bool		 	 isEnvScanning;
+  std::atomic<bool>	 isEnvScanning;
   bool		 	 isAccumulating;
   int			 maxAccumCount;
   
@@ -707,11 +1051,32 @@ public:
   
   void setMatrix( const Matrix3H &matrix );
   void ThreadFunction();
+  enum ScanStage
+  {
+    ConvertStage    = 0,
+    AccumulateStage = 1,
+    DetectStage     = 2,
+    AdaptEnvStage   = 3,
+    NumScanStages   = 4
+  };
+
+  void receiveScan( LidarScanFrame &frame );
+  void processScan( LidarScanFrame &frame );
+  void processScanStage( LidarScanFrame &frame, int stage );
+  void submitScanStage ( LidarScanFrame &frame, int stage );
+  void convertScan   ( LidarScanFrame &frame );
+  void accumulateScan();
+  void detectScan    ( LidarScanFrame &frame );
+  void adaptScanEnv  ( LidarScanFrame &frame );
+  void continueEnvScan( bool result );
+  bool scanAsync();
+  void waitScanProcessed();
   void updateEnv();
   void adaptEnv();
-  void erodeEnv ( LidarSampleBuffer &srcSamples, LidarSampleBuffer &dstSamples, int steps=5  );
-  void smoothEnv( LidarSampleBuffer &samples, int steps=5 );
-  void processEnv();
+  void erodeEnv ( LidarSampleBuffer &srcSamples, LidarSampleBuffer &dstSamples, int steps, int first, int count );
+  void smoothEnv( const LidarSampleBuffer &srcSamples, LidarSampleBuffer &dstSamples, int steps, int first, int count );
+  void markEnvDirty( int angIndex );
+  void processEnv( bool onlyDirty=false );
   void envChanged();
   void sendOutEnv();
 
@@ -728,8 +1093,11 @@ public:
   bool isTempNoiseSample( int angIndex ) const;
   bool addDetectedObject( LidarObjects &objects, int lowerIndex, int higherIndex, bool isSplit=false );
   void addDetectedObject( LidarObjects &objects, int lowerIndex, int higherIndex, float extent, float closest, bool isSplit=false );
+  void addDetectedObject( LidarObjects &objects, const LidarSampleSpan &span );
   void detectObjects();
-  bool scanValid( int angIndex ) const;
+  void classifyScan();
+  bool scanValid( int angIndex ) const
+  { return (scanValidMask[angIndex >> 5] >> (angIndex & 31)) & 1; }
   LidarObjects visibleObjects( const LidarObjects &other ) const;
 
 public:
@@ -753,6 +1121,8 @@ public:
 
   bool scan();
 
+  void updateEnvDistance( int first=0, int count=-1 );
+
   bool writeEnv( const char *path=NULL, uint64_t timestamp=0 );
   bool readEnv ( const char *path=NULL );
   void resetEnv();
@@ -775,6 +1145,9 @@ public:
 
   int   numDetectedObjects() const
   { return objects.size(); }
+
+  void  publishObjects( bool valid, uint64_t timestamp=0 );
+  const LidarObjectsFrame &latestObjects();
   
   LidarObject &detectedObject( int objectIndex )
   { return objects[objectIndex]; }
@@ -807,6 +1180,7 @@ public:
   static void setVerbose( int level );
   static void setInstallDir( const char *path );
   static void setUseStatusIndicator( bool set );
+  static LidarFrameSignal frameSignal;
 
   static std::string defaultDeviceType;
   static std::string configDir;
@@ -936,6 +1310,7 @@ public:
   void 		useEnv ( bool use );
   
   void		update();
+  bool		waitForFrames( uint64_t timeoutUSec );
 
   bool 		parseArg( int &i, const char *argv[], int &argc );
   void 		printArgHelp() const;
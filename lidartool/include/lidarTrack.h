@@ -38,6 +38,7 @@ class LidarTrack : public TrackBase
 public:
 
     std::string					  outFormat;
+    SpatialGrid<int>				  objectGrid;
 
     void	mergeStages ( LidarDevices &devices, uint64_t timestamp );
     void	mergeObjects( LidarDevices &devices, uint64_t timestamp );
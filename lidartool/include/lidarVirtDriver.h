@@ -21,6 +21,8 @@
 #include "sl_lidar.h"
 
 #include <queue>
+#include <bitset>
+#include <atomic>
 
 /***************************************************************************
 *** 
@@ -115,6 +117,7 @@ public:
 class LidarRawSampleBuffer : public std::vector<LidarRawSample> 
 {
 public:
+  static const int nodeCapacity = 4*1024;	// reserved once for a full scan
 };
 
 /***************************************************************************
@@ -126,19 +129,29 @@ public:
 class LidarScanData
 {
 public:
+  static const int maxPackets = 256;
+
   _u64  seqNr;
+  bool	used;
+  int	numPackets;
+  uint64_t arrivalTime;		// usec the last missing packet arrived
   LidarRawSampleBuffer  nodes;
-  std::vector<bool>	packetsReceived;
+  std::bitset<maxPackets> packetsReceived;
 
   LidarScanData( _u64 seqNr=0 )
   : seqNr( seqNr ),
+    used( false ),
+    numPackets( 0 ),
+    arrivalTime( 0 ),
     nodes(),
     packetsReceived()
   {}
 
+  void	reset( _u64 seqNr );
   bool	complete() const;
 
   void	addData( unsigned char *data, int size );
+  static bool decodeCompact( const unsigned char *src, int size, LidarRawSample *dst, int numNodes );
 };
 
 
@@ -148,19 +161,47 @@ public:
 ***
 ****************************************************************************/
 
-class LidarScanDataList : public std::vector<LidarScanData> 
+/*
+  Reassembly ring of the scans currently in flight, the slot of a scan is
+  seqNr % ringSize. A slot still holding an older scan is evicted when a
+  newer scan needs it.
+
+  Packets of scans older than their slot or than the last scan handed out
+  are late or duplicates and dropped, unless they lag by more than
+  restartGap, which is taken as a restart of the sender.
+
+  Node storage of a slot is sized by the totalNodes of the first scan it
+  receives and reused afterwards, so the ring only holds as much memory as
+  the device actually sends per scan.
+*/
+
+class LidarScanDataList
 {
 public:
+  static const int ringSize = 16;
+
+  LidarScanData	slots[ringSize];
+
+  static const int restartGap = 4*ringSize;
+
   _u64  currentSeqNr;
+  bool  currentValid;
   int   seqFailureCount;
-  LidarScanDataList()
-  : currentSeqNr( 0 )
-  {}
+  uint64_t arrivalTime;		// arrivalTime of the scan last handed out
+
+	// read by the web server thread, written by the device thread
+  std::atomic<uint64_t> numCompleted;	// scans handed out by grabScanData()
+  std::atomic<uint64_t> numEvicted;	// incomplete scans overwritten by a newer one
+  std::atomic<uint64_t> numStale;	// scans dropped because a newer one was handed out already
+  std::atomic<uint64_t> numLate;	// packets of scans older than their slot or handed out already
+
+  LidarScanDataList();
 
   bool grabScanData( LidarRawSampleBuffer &nodes, bool grabLatest );
 
-  LidarScanData &getScanData( _u64 seqNr );
-  
+  LidarScanData *getScanData( _u64 seqNr );
+  void		 evict( LidarScanData &scanData, std::atomic<uint64_t> &counter );
+  void		 reset( _u64 seqNr=0 );
 };
 
 
@@ -208,6 +249,7 @@ public:
   SockAddr 		 lastRemoteAddr; 
   bool			 deviceStatusSent;
   bool			 isOpen;
+  bool			 peerCompactFormat;
   
   _u64			 seqNr;
   uint64_t 		 lastRecvTime;
@@ -251,6 +293,10 @@ public:
   int           getRemotePort() const;
   
   static void	setVerbose( int level );
+
+  static int	recvBatchSize;
+  static int	recvBufferSize;
+  static bool	compactFormat;
 };
 
 #endif
@@ -36,6 +36,8 @@ public:
 
     std::string		m_Host;
     int			m_Port;
+
+    PackedTrackable::DeltaDecoder m_DeltaDecoder;
     
 
 